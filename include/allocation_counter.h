@@ -0,0 +1,22 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_ALLOCATION_COUNTER_H_
+#define NONOGRAMS_ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+// Counts the heap allocations of the current thread. The counting operators
+// new and delete of allocation_counter.cpp are linked only into the
+// nonograms_benchmark program, which is built with
+// NONOGRAMS_COUNT_ALLOCATIONS (see CMakeLists.txt). The solver program and
+// the library keep the default operators.
+//
+// Example:
+//    int64_t allocations = ThreadAllocations();
+//    do_a_cool_thing();
+//    allocations = ThreadAllocations() - allocations;
+int64_t ThreadAllocations();
+
+#endif  // NONOGRAMS_ALLOCATION_COUNTER_H_
@@ -8,6 +8,7 @@
 #include <string>
 
 #include <args.hxx>
+#include <solve_options.h>
 
 // The constraints of the arguments parser library allow to handle arguments
 // only via global values
@@ -15,12 +16,33 @@ namespace cli_args {
 extern args::ArgumentParser parser;
 extern args::HelpFlag help;
 extern args::ValueFlag<std::string> inputPuzzle;
+extern args::Flag stream;
+extern args::ValueFlag<std::string> serve;
+extern args::ValueFlag<int> max_in_flight;
+extern args::ValueFlag<int> timeout;
 extern args::ValueFlag<std::string> inputImage;
 extern args::ValueFlag<std::string> imageName;
 extern args::ValueFlag<int> scaleImage;
+extern args::ValueFlag<std::string> image_format;
+extern args::Flag compile;
 extern args::ValueFlag<std::string> benchmark;
+extern args::ValueFlag<std::string> make_pack;
+extern args::ValueFlag<std::string> pack_puzzle;
+extern args::Flag no_mmap;
+extern args::ValueFlag<std::string> load_test;
+extern args::ValueFlag<int> jobs;
 extern args::ValueFlag<int> gif_frame_delay;
 extern args::ValueFlag<int> gif_end_delay;
+extern args::ValueFlag<std::string> line_solver;
+extern args::Flag line_benchmark;
+extern args::ValueFlag<int> line_cache;
+extern args::ValueFlag<std::string> heuristic;
+extern args::Flag compare_heuristics;
+extern args::Flag parse_benchmark;
+extern args::Flag no_overlap;
+extern args::Flag search;
+extern args::ValueFlag<int> threads;
+extern args::ValueFlag<int> count_solutions;
 extern args::Flag black;
 extern args::Flag moves;
 extern args::Flag extra_moves;
@@ -28,6 +50,13 @@ extern args::Flag gif;
 extern args::Flag cool;
 extern args::Flag empty;
 extern args::Flag display;
+extern args::ValueFlag<int> draw_threads;
+extern args::Flag async_log;
+
+// Fills the options of the solver from the parsed arguments, the line cache
+// is given if it's enabled. Returns false if an engine, a heuristic or an
+// image format is unknown
+bool GetSolveOptions(SolveOptions& options);
 }  // namespace cli_args
 
 #endif
@@ -6,14 +6,130 @@
 #define NONOGRAMS_BENCHMARK_H_
 
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <line_scheduler.h>
+#include <one_line_solver.h>
+#include <puzzle.h>
+#include <puzzle_pack.h>
+#include <solve_options.h>
 
 class Benchmark {
  public:
+    // The puzzles are solved with the options
+    explicit Benchmark(const SolveOptions& options);
+
     bool Run(const std::string& path_to_puzzles);
 
+    // Compares the line solver engines and the overlap pre-pass on random
+    // lines of different lengths, checks that they give identical results
+    bool RunLineSolvers();
+
  private:
+    // Reads the names of the files in the folder, or opens the pack and
+    // reads the names of its puzzles
+    bool ListFiles(const std::string& path_to_puzzles,
+            std::vector<std::string>& files);
+
+    // Solves the file by its path or the puzzle of the pack by its name,
+    // only reads it if solve isn't set. The buffer keeps the puzzle read
+    // from the pack which isn't mapped
+    bool RunPuzzle(Puzzle& puzzle, const std::string& path,
+            const std::string& file, bool solve, std::vector<char>& buffer);
+
+    // The results of the files solved by one worker of the benchmark
+    struct RunStats {
+        // The running times and the names of the files
+        std::vector<std::pair<double, std::string>> running_times;
+        int64_t line_solves = 0;
+        // The files with no solutions, one solution and more solutions,
+        // filled with --count-solutions
+        std::vector<std::string> no_solutions;
+        int unique_solutions = 0;
+        std::vector<std::string> many_solutions;
+        // The heap allocations made by solving the files, and the count of
+        // the files solved without them (counted by nonograms_benchmark)
+        int64_t allocations = 0;
+        int files_without_allocations = 0;
+    };
+
+    // Solves the file with the context and adds its results to the stats,
+    // returns false if the file can't be solved
+    bool SolveFile(const std::string& path_to_puzzles,
+            const std::string& file, Puzzle::SolverContext& context,
+            std::vector<char>& buffer, RunStats& stats);
+
+    // Solves all the files several times with one context and fails if the
+    // last round makes heap allocations. Only nonograms_benchmark counts
+    // them (see allocation_counter.h)
+    bool CheckAllocations(const std::string& path_to_puzzles,
+            const std::vector<std::string>& files);
+
+    // Solves all the files with every heuristic of the line scheduler,
+    // compares the line solves count and the time
+    bool RunHeuristics(const std::string& path_to_puzzles,
+            const std::vector<std::string>& files);
+
+    // Reads all the files several times without solving them, measures the
+    // parsing speed
+    bool RunParser(const std::string& path_to_puzzles,
+            const std::vector<std::string>& files);
+
+    // Sends all the files to the server from every connection, a connection
+    // waits for the response before the next request. Measures the latency
+    // and the throughput of the server
+    bool RunLoadTest(const std::string& socket_path,
+            const std::string& path_to_puzzles,
+            const std::vector<std::string>& files);
+
+    // The description of random lines
+    struct LineSet {
+        // The colors count, white included
+        int color_count;
+        int length;
+        // The runs of colors are not longer than max_run
+        int max_run;
+        // Every cell is known with this probability
+        double known_chance;
+    };
+
+    // A line solver to compare
+    struct LineSolverSetup {
+        LineSolverEngine engine;
+        // Used to enable the overlap pre-pass
+        bool overlap;
+        std::string name;
+    };
+
+    // The random lines have few colors, so the narrowest masks are enough
+    typedef uint8_t LineMask;
+
     // The max size of the top of the slowest files
     const int kMaxTopSize = 10;
+
+    // How many random lines of every set are solved
+    const int kLinesCount = 50;
+
+    // How many times every file is read by RunParser()
+    const int kParseRounds = 10;
+
+    // How many times every file is solved by CheckAllocations()
+    const int kAllocationRounds = 3;
+
+    // Solves the same random lines with every engine and compares the time
+    bool RunLineSolvers(const std::vector<LineSolverSetup>& engines,
+            const LineSet& line_set);
+
+    // Generates a random line, returns its groups and cells
+    void GenerateLine(const LineSet& line_set, unsigned seed,
+            std::vector<std::pair<int, int>>& groups,
+            std::vector<LineMask>& cells);
+
+    SolveOptions options_;
+
+    // The puzzles are read from the pack if the benchmark runs on a pack
+    PuzzlePack pack_;
 };
 
 #endif  // NONOGRAMS_BENCHMARK_H_
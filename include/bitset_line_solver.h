@@ -0,0 +1,89 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_BITSET_LINE_SOLVER_H_
+#define NONOGRAMS_BITSET_LINE_SOLVER_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Updates the state of an one-line white-black Japan puzzle, the same way as
+// OneLineSolver does, but processes 64 cells at once.
+//
+// The line is stored as two bitsets - "can be white" and "can be black". The
+// states (X groups placed, Y-th cell) with the same X are stored as a bitset
+// too, where the Y-th bit is set if the state is reachable. Placing the groups
+// and the white cells are shifts, ANDs and ORs of the bitsets.
+//
+// Every cell is a 2-bit mask: the 0-th bit is WHITE, the 1-st bit is BLACK.
+class BitsetLineSolver {
+ public:
+    // Reserves memory
+    void Init(int side_length);
+
+    // Recalculates the state of a line, updating the values of the cell vector
+    // returns false if the puzzle is unsolvable or has wrong state
+    template <typename Mask>
+    bool UpdateState(const std::vector<std::pair<int, int>>& groups,
+            std::vector<Mask>& cells);
+
+ private:
+    // Does the same as UpdateState(), but with the cells packed into white_
+    // and black_, the result is in result_white_ and result_black_
+    bool UpdateBitsets(const std::vector<std::pair<int, int>>& groups,
+            int len);
+
+    // Used to resize the bitsets for the line
+    void Resize(int len, int group_count);
+
+    // dst = src << shift (to the cells with greater indices)
+    void ShiftUp(const uint64_t* src, int shift, uint64_t* dst);
+    // dst = src >> shift (to the cells with less indices)
+    void ShiftDown(const uint64_t* src, int shift, uint64_t* dst);
+
+    // Adds the states reachable from the states via the white cells from
+    // the left to the right
+    void FillRight(uint64_t* states, const uint64_t* white);
+    // Adds the states that reach the states via the white cells from the left
+    // to the right
+    void FillLeft(uint64_t* states, const uint64_t* white);
+
+    // Finds the cells where a group of the length can start
+    void FindFits(int length, uint64_t* fits);
+    // Marks the cells covered by the groups of the length starting from the
+    // starts
+    void Spread(const uint64_t* starts, int length, uint64_t* cells);
+
+    // The count of 64-bit words of every bitset
+    int word_count_;
+
+    // The cells that can be WHITE or BLACK
+    std::vector<uint64_t> white_;
+    std::vector<uint64_t> black_;
+
+    // The [X * word_count_ .. (X + 1) * word_count_) words are the states
+    // with X groups placed, reachable from the start of the line
+    std::vector<uint64_t> prefix_;
+
+    // The states with X and X + 1 groups placed, the end of the line can be
+    // reached from them
+    std::vector<uint64_t> suffix_;
+    std::vector<uint64_t> next_suffix_;
+
+    // The cells that can be WHITE or BLACK in a correct filling
+    std::vector<uint64_t> result_white_;
+    std::vector<uint64_t> result_black_;
+
+    // The [X * word_count_ .. (X + 1) * word_count_) words are the cells
+    // where the X-th group can start
+    std::vector<uint64_t> fits_;
+
+    // Used to save intermediate bitsets
+    std::vector<uint64_t> starts_;
+    std::vector<uint64_t> work_;
+    std::vector<uint64_t> shifted_;
+};
+
+#endif  // NONOGRAMS_BITSET_LINE_SOLVER_H_
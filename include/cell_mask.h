@@ -0,0 +1,94 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_CELL_MASK_H_
+#define NONOGRAMS_CELL_MASK_H_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Every cell of a puzzle is presented as an unsigned integer mask. If it's
+// possible for a cell to have i-th color, its i-th bit in the mask is set to 1.
+//
+// The mask type is the narrowest of uint8_t, uint16_t, uint32_t and uint64_t
+// that has a bit for every color (see Puzzle::Solve()).
+
+// The max count of colors (white included) of a mask type
+template <typename Mask>
+constexpr int MaxMaskColors() {
+    return std::numeric_limits<Mask>::digits;
+}
+
+// The mask with all the colors allowed
+template <typename Mask>
+inline Mask AllColorsMask(int color_count) {
+    if (color_count >= MaxMaskColors<Mask>()) {
+        return std::numeric_limits<Mask>::max();
+    }
+    return static_cast<Mask>((static_cast<Mask>(1) << color_count) - 1);
+}
+
+// The mask with only one color allowed
+template <typename Mask>
+inline Mask ColorMask(int color) {
+    return static_cast<Mask>(static_cast<Mask>(1) << color);
+}
+
+// The count of the allowed colors
+template <typename Mask>
+inline int CountColors(Mask mask) {
+    return __builtin_popcountll(mask);
+}
+
+// The index of the first allowed color, the mask shouldn't be zero
+template <typename Mask>
+inline int FirstColor(Mask mask) {
+    return __builtin_ctzll(mask);
+}
+
+// Checks that only one color is allowed, it's cheaper than CountColors()
+template <typename Mask>
+inline bool IsOneColor(Mask mask) {
+    return mask != 0 && (mask & (mask - 1)) == 0;
+}
+
+// The count of the cells with not only one color allowed (the empty masks
+// are counted too)
+template <typename Mask>
+inline int CountUnknownCells(const Mask* cells, int count) {
+    int unknown = 0;
+    for (int i = 0; i < count; i++) {
+        unknown += !IsOneColor(cells[i]);
+    }
+    return unknown;
+}
+
+// The 8-bit masks are counted by 8 at once as the bytes of a word: the bits
+// of every byte are counted in place, then the bytes with a count other than
+// 1 are summed up
+template <>
+inline int CountUnknownCells<uint8_t>(const uint8_t* cells, int count) {
+    const uint64_t kOnes = 0x0101010101010101ULL;
+    int unknown = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t word;
+        memcpy(&word, cells + i, sizeof(word));
+        word -= (word >> 1) & (kOnes * 0x55);
+        word = (word & (kOnes * 0x33)) + ((word >> 2) & (kOnes * 0x33));
+        word = (word + (word >> 4)) & (kOnes * 0x0f);
+        // The counts are at most 8, so every byte is 0 only if it was 1
+        word ^= kOnes;
+        word |= word >> 2;
+        word |= word >> 1;
+        unknown += ((word & kOnes) * kOnes) >> 56;
+    }
+    for (; i < count; i++) {
+        unknown += !IsOneColor(cells[i]);
+    }
+    return unknown;
+}
+
+#endif  // NONOGRAMS_CELL_MASK_H_
@@ -0,0 +1,54 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_COMPILED_PUZZLE_H_
+#define NONOGRAMS_COMPILED_PUZZLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// The binary format of the puzzles (.pzb), it's read from a mapped file
+// without parsing. The numbers have the byte order of the machine which
+// wrote the file, a file of the other byte order fails the version check.
+//
+// The file is:
+//    the header (CompiledHeader)
+//    the palette - color_count colors of 3 bytes (red, green, blue), the
+//        first one is white, padded with zeros to 4 bytes
+//    the offsets of the groups - rows + columns + 1 uint32_t numbers, the
+//        groups of the i-th line (the rows go first) are the groups
+//        [offsets[i]..offsets[i + 1])
+//    the lengths of the groups - group_count uint16_t numbers
+//    the color indices of the groups - group_count uint8_t numbers
+struct CompiledHeader {
+    // "PZB" and a zero byte
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t columns;
+    // White included
+    uint32_t color_count;
+    // The count of the groups of all the lines
+    uint32_t group_count;
+};
+
+// The positions of the sections of a file with the header
+struct CompiledLayout {
+    explicit CompiledLayout(const CompiledHeader& header) {
+        palette = sizeof(CompiledHeader);
+        offsets = palette + (3 * header.color_count + 3) / 4 * 4;
+        lengths = offsets + (header.rows + header.columns + 1) *
+            sizeof(uint32_t);
+        colors = lengths + header.group_count * sizeof(uint16_t);
+        size = colors + header.group_count * sizeof(uint8_t);
+    }
+
+    size_t palette;
+    size_t offsets;
+    size_t lengths;
+    size_t colors;
+    size_t size;
+};
+
+#endif  // NONOGRAMS_COMPILED_PUZZLE_H_
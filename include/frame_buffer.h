@@ -0,0 +1,92 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_FRAME_BUFFER_H_
+#define NONOGRAMS_FRAME_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+// An RGB image with a byte per channel, the pixels are stored row by row in
+// one buffer. The images are drawn here and handed to the writer at once,
+// instead of setting their pixels one by one.
+//
+// Example:
+//    FrameBuffer buffer(width, height, white);
+//    FrameBand band(buffer);
+//    band.Fill(black, x, y, w, h);
+//    band.Darken(0.9, x, y, w, 1);
+class FrameBuffer {
+ public:
+    // The same as Puzzle::Color
+    typedef std::tuple<uint8_t, uint8_t, uint8_t> Color;
+
+    FrameBuffer(int width, int height, const Color& background);
+
+    int width() const {
+        return width_;
+    }
+    int height() const {
+        return height_;
+    }
+
+    // The bytes of the pixels, r, g and b of every one
+    const uint8_t* data() const {
+        return pixels_.data();
+    }
+
+    uint8_t* row(int y) {
+        return pixels_.data() + static_cast<size_t>(y) * width_ * 3;
+    }
+    const uint8_t* row(int y) const {
+        return pixels_.data() + static_cast<size_t>(y) * width_ * 3;
+    }
+
+ private:
+    int width_;
+    int height_;
+    std::vector<uint8_t> pixels_;
+};
+
+// Draws the shapes clipped to the rows [top..bottom) of a frame buffer.
+// The bands that don't overlap may be drawn by several threads at once, so
+// the big images are drawn by tiles of rows
+class FrameBand {
+ public:
+    typedef FrameBuffer::Color Color;
+
+    // The band of all the rows
+    explicit FrameBand(FrameBuffer& buffer);
+    FrameBand(FrameBuffer& buffer, int top, int bottom);
+
+    int top() const {
+        return top_;
+    }
+    int bottom() const {
+        return bottom_;
+    }
+
+    // Fills the rectangle with the color, the first row of it is filled by
+    // the pixels and the next ones are copied from it
+    void Fill(const Color& color, int x, int y, int width, int height);
+
+    // Copies the pixels of the row to the other row if it's in the band
+    void CopyRow(int from_y, int to_y);
+
+    // Multiplies the channels of the pixels of the rectangle
+    void Darken(double multiplier, int x, int y, int width, int height);
+
+ private:
+    // Clips the rectangle to the band and the image, returns false if
+    // nothing is left
+    bool Clip(int& x, int& y, int& width, int& height) const;
+
+    FrameBuffer& buffer_;
+    int top_;
+    int bottom_;
+};
+
+#endif  // NONOGRAMS_FRAME_BUFFER_H_
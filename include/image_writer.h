@@ -0,0 +1,44 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_IMAGE_WRITER_H_
+#define NONOGRAMS_IMAGE_WRITER_H_
+
+#include <string>
+
+#include <frame_buffer.h>
+
+// The formats of the written images. The png and ppm images are written by
+// ImageWriter without ImageMagick, the magick ones are png images written
+// by ImageMagick, they are smaller but much slower to write
+enum class ImageFormat {
+    kPng,
+    kPpm,
+    kMagick
+};
+
+// Parses the format name ("png", "ppm" or "magick"), returns false if the
+// name is unknown
+bool ParseImageFormat(const std::string& name, ImageFormat& format);
+
+// The extension of the image files of the format, with the dot
+const char* ImageExtension(ImageFormat format);
+
+// Writes the frame buffers to the files without any libraries.
+//
+// The png images are compressed by a light deflate: the bytes are coded by
+// the fixed Huffman codes, and the repeats of the previous pixel or of the
+// pixels of the previous row are coded as matches. The images of the puzzles
+// are mostly the runs of the same color and the copied rows, so they are
+// compressed well without searching for the matches
+class ImageWriter {
+ public:
+    // Return false if the file can't be written
+    static bool WritePng(const FrameBuffer& buffer,
+            const std::string& filename);
+    static bool WritePpm(const FrameBuffer& buffer,
+            const std::string& filename);
+};
+
+#endif  // NONOGRAMS_IMAGE_WRITER_H_
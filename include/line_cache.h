@@ -0,0 +1,82 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_LINE_CACHE_H_
+#define NONOGRAMS_LINE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Remembers the results of the line solver. The key is the groups and the
+// cells of a line packed to bytes, the value is the updated cells. The same
+// lines are met in the same puzzle and in the other puzzles of a benchmark,
+// so the cache is shared, uses pseudo-singleton structure like Logger.
+//
+// The memory is bounded, when it's full the entries are evicted with the
+// clock algorithm: an entry gets a second chance if it was found since
+// the last time the clock hand passed it.
+//
+// The cache is used by the line solvers of all the threads, so every call is
+// guarded by a mutex.
+//
+// Example:
+//    LineCache::get()->Init(64 * 1024 * 1024);
+//    std::string cells;
+//    if (LineCache::get()->Find(key, cells)) { ... }
+class LineCache {
+ public:
+    static LineCache* get();
+
+    // Sets the memory limit in bytes and clears the cache, 0 disables it
+    void Init(size_t max_memory);
+
+    bool Enabled() const {
+        return max_memory_ > 0;
+    }
+
+    // Copies the cells of the key, returns false if there is no such key
+    bool Find(const std::string& key, std::string& cells);
+
+    // Adds the cells of the key, evicts other entries if the memory is full
+    void Insert(const std::string& key, const std::string& cells);
+
+    // Logs hit and miss counts, entries count and used memory
+    void LogStats() const;
+
+ private:
+    // The approximate memory used by an entry besides its key and cells
+    const size_t kEntryOverhead = 64;
+
+    struct Entry {
+        // Points to the key in index_, nullptr if the entry is free
+        const std::string* key;
+        std::string cells;
+        // Set when the entry is found, cleared when the clock hand passes it
+        bool referenced;
+    };
+
+    // Removes an entry chosen by the clock hand
+    void Evict();
+
+    size_t EntryMemory(const Entry& entry) const;
+
+    mutable std::mutex mutex_;
+
+    std::unordered_map<std::string, int> index_;
+    std::vector<Entry> entries_;
+    std::vector<int> free_entries_;
+    size_t clock_hand_ = 0;
+
+    size_t memory_ = 0;
+    size_t max_memory_ = 0;
+
+    int64_t hits_ = 0;
+    int64_t misses_ = 0;
+};
+
+#endif  // NONOGRAMS_LINE_CACHE_H_
@@ -0,0 +1,101 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_LINE_SCHEDULER_H_
+#define NONOGRAMS_LINE_SCHEDULER_H_
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Chooses the next line of a puzzle to be solved. Every line is solved at
+// least once, then a line is queued again only when a cell crossing it has
+// changed. The rows are the lines [0..n), the columns are the lines [n..n+m).
+//
+// The heuristics:
+//    sweep - all the queued rows, then all the queued columns, and so on
+//    fixed - the line with the most cells got known colors since it was
+//        solved
+//    slack - the line with the least slack (length minus the least length
+//        of the groups), it's the most constrained one
+//    unknown - the line with the least unknown cells
+// The lines with the same priority are taken in the order of their indices.
+class LineScheduler {
+ public:
+    enum class Heuristic {
+        kSweep,
+        kFixed,
+        kSlack,
+        kUnknown
+    };
+
+    // Parses the heuristic name, returns false if the name is unknown
+    static bool ParseHeuristic(const std::string& name, Heuristic& heuristic);
+
+    // Returns the names of all the heuristics
+    static const std::vector<std::pair<Heuristic, std::string>>&
+            Heuristics();
+
+    // Queues all the lines, or none of them if queue_all isn't set (then the
+    // changed lines are pushed by the caller)
+    void Init(Heuristic heuristic,
+            const std::vector<std::vector<std::pair<int, int>>>& row_groups,
+            const std::vector<std::vector<std::pair<int, int>>>& col_groups,
+            bool queue_all = true);
+
+    // Takes the next line, returns false if there are no queued lines.
+    // new_step is set when the line starts a new step of the solution (a new
+    // sweep, or n + m lines solved for the other heuristics)
+    bool Pop(int& line, bool& new_step);
+
+    // Takes all the queued lines of the current half-sweep (the rows or the
+    // columns), they don't cross each other and may be solved in parallel.
+    // Works only with the sweep heuristic
+    bool PopBatch(std::vector<int>& lines, bool& new_step);
+
+    // A cell of the line has changed, known is set if its color is known now
+    void Push(int line, bool known);
+
+    // The line was solved, unknown_cells of its cells are still unknown
+    void Solved(int line, int unknown_cells);
+
+ private:
+    // Used to compare the lines, the greater one is solved first
+    int64_t Priority(int line) const;
+
+    // Adds the line to the queue of its heuristic
+    void Enqueue(int line);
+
+    Heuristic heuristic_;
+    int row_count_;
+    int line_count_;
+
+    // The i-th element is set if the i-th line is in the queue
+    std::vector<int8_t> queued_;
+    // The i-th element is set if all the cells of the i-th line are known
+    std::vector<int8_t> dead_;
+
+    // The scores of the lines
+    std::vector<int> fixed_;
+    std::vector<int> slack_;
+    std::vector<int> unknown_;
+
+    // Used by the sweep heuristic. The queued rows and columns, and the lines
+    // of the current sweep
+    std::vector<int> rows_;
+    std::vector<int> cols_;
+    std::vector<int> solving_;
+    size_t solving_pos_;
+    bool solving_rows_;
+
+    // Used by the other heuristics. The priority of a line is changed with
+    // a new element, the elements with old priorities are skipped
+    std::priority_queue<std::pair<int64_t, int>> queue_;
+    std::vector<int64_t> priority_;
+    int64_t popped_;
+};
+
+#endif  // NONOGRAMS_LINE_SCHEDULER_H_
@@ -5,26 +5,98 @@
 #ifndef NONOGRAMS_LOGGER_H_
 #define NONOGRAMS_LOGGER_H_
 
+#include <memory>
+
+#include <spdlog/async.h>
+#include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
+// The messages below this level are compiled out, the release builds keep
+// the info messages and the debug builds keep everything (see
+// CMakeLists.txt)
+#ifndef NONOGRAMS_LOG_LEVEL
+#define NONOGRAMS_LOG_LEVEL SPDLOG_LEVEL_INFO
+#endif
+
+// The arguments of these messages aren't evaluated when they are compiled
+// out, so they may be used in the hot paths
+#if NONOGRAMS_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+#define LOG_TRACE(...) Logger::get()->trace(__VA_ARGS__)
+#else
+#define LOG_TRACE(...) static_cast<void>(0)
+#endif
+#if NONOGRAMS_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::get()->debug(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) static_cast<void>(0)
+#endif
+
 // Logs everything if necessary, uses pseudo-singleton structure
 // Init() should be called before using
 // Example:
-//    Logger::get()->Init();
-//    Logger::get()->debug(...);  // or warn(), info(), error(), etc.
+//    Logger::Init();
+//    Logger::get()->info(...);  // or warn(), error(), etc.
+//    LOG_DEBUG(...);  // or LOG_TRACE()
+//
+// The logger is kept in a static pointer, so get() doesn't look it up in
+// the registry of spdlog. It's replaced only by the functions below, before
+// the threads using it start. The sinks are thread-safe, the search logs
+// from threads.
 class Logger {
  public:
     static void Init() {
         SetLevel(spdlog::level::debug);
-        spdlog::stdout_color_st("Nonograms");  // init single-threaded
+        Create(false, false);
+    }
+
+    // Creates the logger again. It writes the messages to stderr instead of
+    // stdout if use_stderr is set, used if stdout is taken by the results.
+    // An async logger queues the messages, they are formatted and written
+    // by its own thread, so the solving threads don't wait for the output
+    static void Create(bool use_stderr, bool async) {
+        spdlog::drop(kName);
+        std::shared_ptr<spdlog::logger> logger;
+        if (async) {
+            logger = use_stderr ?
+                spdlog::stderr_color_mt<spdlog::async_factory>(kName) :
+                spdlog::stdout_color_mt<spdlog::async_factory>(kName);
+        } else {
+            logger = use_stderr ? spdlog::stderr_color_mt(kName) :
+                spdlog::stdout_color_mt(kName);
+        }
+        instance() = logger;
+    }
+
+    // Writes the warnings and the errors to stderr if Init() wasn't called,
+    // used by the library called from another program
+    static void InitLibrary() {
+        if (!instance()) {
+            instance() = spdlog::stderr_color_mt(kName);
+            instance()->set_level(spdlog::level::warn);
+        }
+    }
+
+    // Writes the messages queued by the async logger and stops its thread,
+    // called at the exit
+    static void Shutdown() {
+        instance().reset();
+        spdlog::shutdown();
     }
 
     static void SetLevel(spdlog::level::level_enum log_level) {
         spdlog::set_level(log_level);
     }
 
-    static auto get() {
-        return spdlog::get("Nonograms");
+    static spdlog::logger* get() {
+        return instance().get();
+    }
+
+ private:
+    static constexpr const char* kName = "Nonograms";
+
+    static std::shared_ptr<spdlog::logger>& instance() {
+        static std::shared_ptr<spdlog::logger> logger;
+        return logger;
     }
 };
 
@@ -0,0 +1,47 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_MAPPED_FILE_H_
+#define NONOGRAMS_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// Maps a whole file to the memory for reading, so it's parsed without
+// copying it to a buffer. The memory is unmapped by the destructor.
+//
+// Example:
+//    MappedFile file;
+//    if (file.Open("puzzle.pzl")) {
+//        TextScanner scanner(file.data(), file.size());
+//        ...
+//    }
+class MappedFile {
+ public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file can't be opened or mapped
+    bool Open(const std::string& filename);
+
+    void Close();
+
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+ private:
+    // An empty file isn't mapped, data_ points to an empty string then
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+};
+
+#endif  // NONOGRAMS_MAPPED_FILE_H_
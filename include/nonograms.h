@@ -0,0 +1,130 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_NONOGRAMS_H_
+#define NONOGRAMS_NONOGRAMS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The C interface of the nonograms library. Every call solves its puzzle
+// with its own buffers and options, so the calls may run at once on many
+// threads. The library writes the warnings and the errors to stderr unless
+// the program has created its logger (see logger.h).
+//
+// Example:
+//    nono_config config = {text, strlen(text), NONO_FORMAT_COLORED, "cat"};
+//    nono_options opts;
+//    nono_options_init(&opts);
+//    nono_result result;
+//    if (nono_solve(&config, &opts, &result) == NONO_SOLVED) { ... }
+//    nono_result_free(&result);
+
+// The formats of the puzzles, the text ones are .pzl, the compiled one is
+// .pzb (see compiled_puzzle.h)
+enum nono_format {
+    NONO_FORMAT_COLORED = 0,
+    NONO_FORMAT_BLACK = 1,
+    NONO_FORMAT_COMPILED = 2
+};
+
+// The white-black lines are solved by the bitset engine by default, the
+// colored ones by the recursive one
+enum nono_line_solver {
+    NONO_LINE_SOLVER_DEFAULT = 0,
+    NONO_LINE_SOLVER_ITERATIVE = 1,
+    NONO_LINE_SOLVER_RECURSIVE = 2,
+    NONO_LINE_SOLVER_BITSET = 3
+};
+
+// The order of solving the lines (see line_scheduler.h)
+enum nono_heuristic {
+    NONO_HEURISTIC_SWEEP = 0,
+    NONO_HEURISTIC_FIXED = 1,
+    NONO_HEURISTIC_SLACK = 2,
+    NONO_HEURISTIC_UNKNOWN = 3
+};
+
+enum nono_status {
+    // All the cells are known
+    NONO_SOLVED = 0,
+    // The lines and the search can't find the only solution, or there are
+    // no solutions
+    NONO_UNSOLVED = 1,
+    NONO_TIMED_OUT = 2,
+    // The puzzle can't be read
+    NONO_INVALID_PUZZLE = 3,
+    // The options are wrong or the memory can't be allocated
+    NONO_ERROR = 4
+};
+
+typedef struct nono_config {
+    // The puzzle in the format, it isn't copied unless the compiled one isn't
+    // aligned to 4 bytes
+    const char* data;
+    size_t size;
+    // One of nono_format
+    int format;
+    // The name of the puzzle in the logs, may be NULL
+    const char* name;
+} nono_config;
+
+typedef struct nono_options {
+    // One of nono_line_solver
+    int line_solver;
+    // One of nono_heuristic
+    int heuristic;
+    // Nonzero to solve the lines with unknown cells by the overlap of the
+    // groups first
+    int overlap;
+    // Nonzero to guess the cells when the lines can't be solved further
+    int search;
+    // Count the solutions with the search up to the limit, 0 is not counting
+    int count_solutions;
+    // The threads of the search and of the sweeps of the big puzzles, 0 is
+    // the count of the hardware threads. 1 by default, as the callers may
+    // solve many puzzles at once
+    int threads;
+    // The time limit of the solving (in ms), 0 is no limit
+    int timeout;
+} nono_options;
+
+typedef struct nono_result {
+    // One of nono_status, the same as returned by nono_solve()
+    int status;
+    int rows;
+    int columns;
+    // The color indices of the cells in the row-major order, -1 is an
+    // unknown cell. NULL if the puzzle can't be read
+    int* cells;
+    // The r, g and b bytes of every color, the first color is white
+    int color_count;
+    uint8_t* colors;
+    // The count of the solutions found with count_solutions (it's not more
+    // than the limit), -1 if they aren't counted
+    int solution_count;
+    int64_t line_solves;
+} nono_result;
+
+// Fills the options with the defaults
+void nono_options_init(nono_options* opts);
+
+// Solves the puzzle, the options may be NULL for the defaults. The result
+// is always filled and has to be freed by nono_result_free(). Returns the
+// status of the result
+int nono_solve(const nono_config* config, const nono_options* opts,
+        nono_result* out);
+
+// Frees the cells and the colors of the result
+void nono_result_free(nono_result* result);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // NONOGRAMS_NONOGRAMS_H_
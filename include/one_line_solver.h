@@ -5,58 +5,158 @@
 #ifndef NONOGRAMS_ONE_LINE_SOLVER_H_
 #define NONOGRAMS_ONE_LINE_SOLVER_H_
 
+#include <string>
 #include <utility>
 #include <vector>
 
+#include <bitset_line_solver.h>
+#include <cell_mask.h>
+#include <line_cache.h>
+
+// There are two engines with the same results: the recursive one walks the
+// states with memoization, the iterative one computes prefix and suffix
+// reachability of the states in two loops over a flat buffer. White-black
+// lines may also be solved by the bitset engine (see BitsetLineSolver).
+enum class LineSolverEngine {
+    kRecursive,
+    kIterative,
+    kBitset
+};
+
+// Parses the engine name ("iterative", "recursive" or "bitset"), returns
+// false if the name is unknown
+bool ParseLineSolverEngine(const std::string& name, LineSolverEngine& engine);
+
 // Updates the state of an one-line colored Japan puzzle, given necessary
 // groups description and the current cells state.
 //
 // Every group has its non-white color index and length, and expressed
 // via std::pair
 //
-// Every cell of a puzzle is presented as an int value. If it's possible for
-// a cell to have i-th color,  its i-th bit in the value is set to 1.
+// Every cell of a puzzle is presented as a Mask value (see cell_mask.h).
 //
 // Usually the count of colors doesn't exceed 11 (white + 10 additional),
-// though with uint32 it may have 32 colors.
+// though with uint64_t masks it may have 64 colors.
+template <typename Mask>
 class OneLineSolver {
  public:
-    // Checks color count, reserves memory
-    bool Init(int side_length, int color_count);
+    typedef LineSolverEngine Engine;
+
+    // Checks color count (the bitset engine works only with 2 colors),
+    // reserves memory
+    bool Init(int side_length, int color_count,
+            Engine engine = Engine::kRecursive);
 
     // Recalculates the state of a line, updating the values of the cell vector
     // returns false if the puzzle is unsolvable or has wrong state
     // Passing by reference is faster than returning some intermediate info
+    // If changed isn't nullptr, the indices of the updated cells are put there
     bool UpdateState(const std::vector<std::pair<int, int>>& groups,
-            std::vector<int>& cells);
+            std::vector<Mask>& cells, std::vector<int>* changed = nullptr);
+
+    // Makes UpdateState() look for the lines in the cache before solving
+    // them, nullptr disables it
+    void SetLineCache(LineCache* cache) {
+        line_cache_ = cache;
+    }
+
+    // Enables the overlap pre-pass (it's enabled by Init())
+    void SetOverlap(bool overlap) {
+        overlap_ = overlap;
+    }
+
+    // Doesn't log the lines which can't be solved, the search meets them in
+    // its wrong branches (it's disabled by Init())
+    void SetQuiet(bool quiet) {
+        quiet_ = quiet;
+    }
+
+    // The counts of the lines solved by the overlap pre-pass and by the full
+    // line solving since Init()
+    int64_t overlap_solves() const {
+        return overlap_solves_;
+    }
+    int64_t full_solves() const {
+        return full_solves_;
+    }
 
  private:
-    const int kMaxColorsCount = 31;
+    const int kMaxColorsCount = MaxMaskColors<Mask>();
     const int kMaxPreferredColorsCount = 11;
 
     bool CheckMaxColorsOverflow(int color_count);
     void CheckMaxPreferredColorsOverflow(int color_count);
-    void AllocMemory(int side_length);
+    void AllocMemory(int side_length, int color_count);
+
+    // Does the same as UpdateState(), but without the changed cells
+    bool UpdateCells(const std::vector<std::pair<int, int>>& groups,
+            std::vector<Mask>& cells);
+
+    // Solves the line in O(len) with the leftmost and the rightmost placements
+    // of the groups, returns false if it can't be done exactly. It's exact
+    // when every cell can have white and the colors of all the groups: then
+    // a group can start anywhere between its leftmost and rightmost places,
+    // and a cell must be colored only if the places of some group overlap on
+    // it. It's always so on the first sweep.
+    bool SolveOverlap(const std::vector<std::pair<int, int>>& groups,
+            std::vector<Mask>& cells);
+
+    // Does the same as UpdateState(), but without the cache
+    bool SolveLine(const std::vector<std::pair<int, int>>& groups,
+            std::vector<Mask>& cells);
+
+    // Packs the mask width, the groups and the cells to line_cache_key_
+    void MakeCacheKey(const std::vector<std::pair<int, int>>& groups,
+            const std::vector<Mask>& cells);
+
+    // Builds run_lengths_ for white and the colors of the groups, clears
+    // their placements_
+    void BuildRunLengths(const std::vector<std::pair<int, int>>& groups,
+            const std::vector<Mask>& cells);
+    void BuildRunLength(const std::vector<Mask>& cells, int color);
 
     // Determines the possibility of filling the cells interval [lbound..rbound]
-    // with a certain color
-    bool CanPlaceColor(const std::vector<int>& cells, int color, int lbound,
+    // with a certain color, works in O(1) with run_lengths_
+    bool CanPlaceColor(const std::vector<Mask>& cells, int color, int lbound,
             int rbound);
 
     // Remembers that there is a correct puzzle filling, where the interval
-    // [lbound..rbound] is filled with a certain color
+    // [lbound..rbound] is filled with a certain color, works in O(1) with
+    // placements_
     void SetPlaceColor(int color, int lbound, int rbound);
 
+    // Adds the placed colors to result_cells_ with one pass over placements_
+    void SweepPlacements(int len);
+
     // Calling CanFill(G, C, X, Y) shows if it's possible to reach the end of
     // the puzzle, if we have placed X groups from G and currently are on the
     // Y-th cell from C.
     bool CanFill(const std::vector<std::pair<int, int>>& groups,
-            const std::vector<int>& cells, int current_group,
-            int current_cell);
+            const std::vector<Mask>& cells, int current_group = 0,
+            int current_cell = 0);
+
+    // Returns the cell to continue from after placing the group on the cell,
+    // or -1 if the group can't be placed there
+    int PlaceGroup(const std::vector<std::pair<int, int>>& groups,
+            const std::vector<Mask>& cells, int group, int cell);
+
+    // Finds which counts of placed groups are possible on every cell if we
+    // don't look at the cells state, returns false if the groups don't fit
+    bool FindGroupBounds(const std::vector<std::pair<int, int>>& groups,
+            int len);
+
+    // Remembers that the state (X groups placed, Y-th cell) is reachable from
+    // the start of the line
+    void MarkReachable(int cell, int group, int stride);
+
+    // Does the same as CanFill(), but without recursion: fills the prefix
+    // reachability of the states, then the suffix one marking the cells
+    bool CanFillIterative(const std::vector<std::pair<int, int>>& groups,
+            const std::vector<Mask>& cells);
 
     // Debug logs of groups and cells
     void DebugLog(const std::vector<std::pair<int, int>>& groups,
-            const std::vector<int>& cells);
+            const std::vector<Mask>& cells);
 
     // Used to save the last UpdateState() call count, when the [X][Y] element
     // was calculated, and protects from recalculations
@@ -69,10 +169,71 @@ class OneLineSolver {
 
     // Used to save intermediate results (cells bit masks) before updating
     // the cells vector
-    std::vector<int> result_cells_;
+    std::vector<Mask> result_cells_;
+
+    // Built once per UpdateState() call, the [C * (side_length + 1) + Y]
+    // element is the length of the longest run starting from the Y-th cell,
+    // where every cell can have the C-th color
+    std::vector<int> run_lengths_;
+
+    // Used to build run_lengths_ only once for every color, the C-th element
+    // is the last UpdateState() call count when the C-th color was built
+    std::vector<int> run_lengths_built_;
+
+    // The difference array of the placed colors, the [C * (side_length + 1)
+    // + Y] element is the count of the C-th color intervals starting on the
+    // Y-th cell minus the count of ones ending right before it
+    std::vector<int> placements_;
+
+    // The colors of the line, their placements_ are swept
+    std::vector<int> line_colors_;
+
+    int side_length_;
+
+    // Used by the iterative engine. The first half keeps the prefix
+    // reachability, the second half keeps the suffix reachability, the state
+    // (X groups placed, Y-th cell) is stored at [Y * (groups + 1) + X].
+    // A reachable state of the prefix also keeps the cell to continue from
+    // after placing the X-th group, plus 2 (see PlaceGroup())
+    std::vector<int> reachable_;
+
+    // Used by the iterative engine. The first (groups + 1) elements are the
+    // least lengths of the groups prefixes, then the [2 * Y] and [2 * Y + 1]
+    // elements are the bounds of the placed groups count on the Y-th cell
+    std::vector<int> group_bounds_;
+
+    // Used by the iterative engine. The [2 * Y] and [2 * Y + 1] elements are
+    // the bounds of the placed groups count of the reachable states on the
+    // Y-th cell
+    std::vector<int> reachable_groups_;
+
+    //  Used to manage recalculations, increments when UpdateState() is called.
+    // It isn't reset by Init(), so the cache_ and run_lengths_built_ entries
+    // left from the previous puzzle of a reused solver never match again
+    int cache_count_ = 0;
+
+    Engine engine_;
+
+    // Used by the bitset engine
+    BitsetLineSolver bitset_solver_;
+
+    // Used to reuse the results of the same lines
+    LineCache* line_cache_;
+    std::string line_cache_key_;
+    std::string line_cache_cells_;
+
+    // Used to find the changed cells
+    std::vector<Mask> old_cells_;
+
+    // Used by the overlap pre-pass. The leftmost starts of the groups, and
+    // the count of the groups of every color which can cover the current cell
+    bool overlap_;
+    std::vector<int> overlap_starts_;
+    std::vector<int> overlap_colors_;
+    int64_t overlap_solves_;
+    int64_t full_solves_;
 
-    //  Used to manage recalculations, increments when UpdateState() is called
-    int cache_count_;
+    bool quiet_;
 };
 
 #endif  // NONOGRAMS_ONE_LINE_SOLVER_H_
@@ -5,45 +5,70 @@
 #ifndef NONOGRAMS_PAINT_H_
 #define NONOGRAMS_PAINT_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
+#include <frame_buffer.h>
 #include <puzzle.h>
+#include <solve_options.h>
 
-namespace Magick {
-class Image;
-class ColorRGB;
-}
-
-// A set of functions used to manage images (display, encode, write)
+// A set of functions used to manage images (display, encode, write). Every
+// puzzle draws with its own Paint, which keeps the frames of its gif. The
+// images are drawn to a frame buffer, it's written by ImageWriter or handed
+// to Magick++ once. Magick++ is initialized by the first image it handles,
+// the program may be built without it (see CMakeLists.txt), then the images
+// can't be displayed or read and the gifs can't be written
 class Paint {
  public:
-    static void DrawCoolImage(const Puzzle::Config& config,
+    explicit Paint(const DrawOptions& options);
+    ~Paint();
+
+    template <typename Mask>
+    void DrawCoolImage(const Puzzle::Config<Mask>& config,
             int image_count = 0);
-    static void DrawImage(const Puzzle::Config& config, int image_count = 0);
+    template <typename Mask>
+    void DrawImage(const Puzzle::Config<Mask>& config, int image_count = 0);
 
-    static void PushCoolFrame(const Puzzle::Config& config);
-    static void PushFrame(const Puzzle::Config& config);
+    template <typename Mask>
+    void PushCoolFrame(const Puzzle::Config<Mask>& config);
+    template <typename Mask>
+    void PushFrame(const Puzzle::Config<Mask>& config);
 
-    static void ReleaseFrames();
+    // Writes the pushed frames to the gif, the last one has the end delay
+    void ReleaseFrames();
 
     static void EncodeImage(const std::string& image_path,
             const std::string& filename);
 
  private:
-    static void WriteImage(Magick::Image& image, int image_counter);
+    void WriteImage(const FrameBuffer& buffer, int image_counter);
+    void PushGifFrame(FrameBuffer&& buffer);
+
+    template <typename Mask>
+    FrameBuffer CreateCoolImage(const Puzzle::Config<Mask>& config);
+    template <typename Mask>
+    FrameBuffer CreateImage(const Puzzle::Config<Mask>& config);
 
-    static Magick::Image CreateCoolImage(const Puzzle::Config& config);
-    static Magick::Image CreateImage(const Puzzle::Config& config);
+    // Draws the bands of the rows of the buffer, the bands of a big image
+    // are drawn by the threads at once if there are several ones
+    void DrawBands(FrameBuffer& buffer,
+            const std::function<void(FrameBand&)>& draw) const;
 
-    static std::string GetImageFilename(int image_counter);
-    static std::string GetGifFilename();
+    std::string GetImageFilename(int image_counter) const;
+    std::string GetGifFilename() const;
 
-    static const char* kImageExtension;
     static const char* kGifExtension;
 
+    // The images with at least kParallelPixels pixels are drawn by the
+    // bands of kBandRows rows on several threads
+    const int kBandRows = 64;
+    const int kParallelPixels = 1 << 20;
+
+    DrawOptions options_;
+
     // Used to manage GIF image frames
-    static std::vector<Magick::Image> gif_frames_;
+    std::vector<FrameBuffer> gif_frames_;
 };
 
 
@@ -5,20 +5,31 @@
 #ifndef NONOGRAMS_PUZZLE_H_
 #define NONOGRAMS_PUZZLE_H_
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include <line_scheduler.h>
 #include <one_line_solver.h>
+#include <solve_options.h>
+#include <text_scanner.h>
+#include <thread_pool.h>
 
-// Reads the puzzle from a file and solves it
+class Paint;
+
+// Reads the puzzle from a file and solves it with the options given to the
+// constructor, it doesn't read the command line. The puzzles with their own
+// contexts may be solved at once on several threads
 class Puzzle {
  public:
     typedef std::tuple<uint8_t, uint8_t, uint8_t> Color;
 
-    struct Config {
+    // The puzzle as it's read from a file
+    struct Description {
         std::string filename;
         int n;
         int m;
@@ -26,48 +37,368 @@ class Puzzle {
         std::vector<Color> colors;
         std::vector<std::vector<std::pair<int, int>>> row_groups;
         std::vector<std::vector<std::pair<int, int>>> col_groups;
-        std::vector<std::vector<int>> row_masks;
-        std::vector<std::vector<int>> col_masks;
+        // The groups of the lines removed for a smaller puzzle, they are
+        // kept to read the next puzzles without allocations
+        std::vector<std::vector<std::pair<int, int>>> spare_row_groups;
+        std::vector<std::vector<std::pair<int, int>>> spare_col_groups;
+    };
+
+    // The puzzle with the state of its cells, the mask type is the narrowest
+    // one that has a bit for every color (see cell_mask.h). The cells are
+    // stored once in the row-major order, a line is copied to a buffer to be
+    // solved and its changed cells are copied back
+    template <typename Mask>
+    struct Config : Description {
+        std::vector<Mask> cells;
+
+        Mask& cell(int row, int col) {
+            return cells[row * m + col];
+        }
+        Mask cell(int row, int col) const {
+            return cells[row * m + col];
+        }
+
+        // Copies the cells of a line to the buffer, the rows are the lines
+        // [0..n), the columns are the lines [n..n+m)
+        void ReadLine(int line, std::vector<Mask>& line_cells) const {
+            if (line < n) {
+                line_cells.assign(cells.begin() + line * m,
+                        cells.begin() + (line + 1) * m);
+                return;
+            }
+            line_cells.resize(n);
+            for (int row = 0, pos = line - n; row < n; row++, pos += m) {
+                line_cells[row] = cells[pos];
+            }
+        }
+
+        // Copies the cells of several rows or several columns to the
+        // buffers, the columns are read row by row, so every row is read
+        // once for all of them
+        void ReadLines(const int* lines, int count,
+                std::vector<std::vector<Mask>>& line_cells) const {
+            if (lines[0] < n) {
+                for (int i = 0; i < count; i++) {
+                    ReadLine(lines[i], line_cells[i]);
+                }
+                return;
+            }
+            for (int i = 0; i < count; i++) {
+                line_cells[i].resize(n);
+            }
+            for (int row = 0, pos = -n; row < n; row++, pos += m) {
+                for (int i = 0; i < count; i++) {
+                    line_cells[i][row] = cells[pos + lines[i]];
+                }
+            }
+        }
+
+        // Copies the changed cells of a line from the buffer
+        void WriteCells(int line, const std::vector<Mask>& line_cells,
+                const std::vector<int>& changed) {
+            for (int i : changed) {
+                (line < n ? cell(line, i) : cell(i, line - n)) = line_cells[i];
+            }
+        }
     };
 
+    // The buffers of the solving kept between the puzzles, defined below
+    struct SolverContext;
+
+    // Solves with the default options
+    Puzzle();
+    explicit Puzzle(const SolveOptions& options);
+    // Solves with the buffers of the context, so the puzzles solved one by
+    // one with the same context don't allocate the memory again. A context
+    // is used by one puzzle at a time
+    Puzzle(const SolveOptions& options, SolverContext* context);
+    ~Puzzle();
+
     // Returns true if read correctly
     bool ReadColored(const std::string& filename);
     bool ReadBlack(const std::string& filename);
+    bool ReadCompiled(const std::string& filename);
+    // Read the puzzle from the memory, the compiled one has to be aligned
+    // to 4 bytes
+    bool ReadColored(const char* data, size_t size);
+    bool ReadBlack(const char* data, size_t size);
+    bool ReadCompiled(const char* data, size_t size);
+    // Reads the compiled puzzle if the file has the .pzb extension, the
+    // white-black one if the options are black, or the colored one
+    bool Read(const std::string& filename);
+    // Reads the puzzle from the memory, the format is chosen by the name
+    // like Read() does
+    bool Read(const std::string& name, const char* data, size_t size);
+    // Writes the read puzzle to the binary format (see compiled_puzzle.h),
+    // returns false if it can't be written or doesn't fit in the format
+    bool WriteCompiled(const std::string& filename) const;
+    // Checks if the file has the extension of the compiled puzzles
+    static bool IsCompiled(const std::string& filename);
+    static const char* kCompiledExtension;
     // Returns true if solved successfully
     bool Solve(const std::string& filename);
+    bool Solve(const std::string& name, const char* data, size_t size);
+    // Solves the puzzle read by one of the Read functions
+    bool Solve();
+    // Sets the name of the puzzle in the logs, Solve() with a name sets it
+    void SetName(const std::string& name);
+    // Returns the count of line solves of the last Solve() call
+    int64_t line_solves() const {
+        return line_solves_;
+    }
+    // Returns the count of the solutions found by the last Solve() call with
+    // --count-solutions (it's not more than the limit), -1 if not counted
+    int solution_count() const {
+        return solution_count_;
+    }
+    // Puts the sizes of the last solved puzzle and the colors of its cells
+    // in the row-major order, -1 is put for the cells which aren't known
+    void GetCells(int& rows, int& columns, std::vector<int>& colors) const;
+    // Returns the colors of the last solved puzzle, the first one is white
+    const std::vector<Color>& colors() const;
+    // Stops solving at this time, then Solve() returns false and
+    // timed_out() is set
+    void SetDeadline(std::chrono::steady_clock::time_point deadline);
+    bool timed_out() const {
+        return timed_out_;
+    }
     // Returns true if a new iteration of solution went correctly
     bool IterationSolve();
     // Parses strings like "#d7d7d7" to Color type
     static Color ParseColor(const std::string& hex_color);
+    static Color ParseColor(const char* hex_color, size_t length);
 
  private:
-    // Reads all the colors to config_
-    bool ReadColorsFromStream(std::ifstream& fin);
+    // Reads all the colors to the description of the context
+    bool ReadColors(TextScanner& scanner);
+
+    // Fills the color table of the context with the colors of the
+    // description, the table is a hash table with linear probing, the keys
+    // are the 24-bit values of the colors
+    void BuildColorTable();
+    // Returns the index of the last color with this value, or 0 (white) if
+    // there is no such color
+    int FindColor(int r, int g, int b) const;
+
+    // The version of the compiled format written by WriteCompiled(), the
+    // max length of the lines and the max count of the colors it can keep
+    const uint32_t kCompiledVersion = 1;
+    const int kMaxCompiledLength = UINT16_MAX;
+    const int kMaxCompiledColors = UINT8_MAX + 1;
+    // The max count of the rows and the columns of a text puzzle, the
+    // bigger sizes are mistakes in the file
+    const int kMaxLength = 10000;
+
+    // The color table has at least this size, a power of 2
+    const size_t kMinColorTableSize = 16;
+    // The hash of a color value is its product with this number (it's the
+    // golden ratio of 2^32), shifted right by 16 bits
+    const uint32_t kColorHashMultiplier = 0x9E3779B1;
+
+    // Solves the lines on one thread, the lines of a half-sweep are taken
+    // by blocks and copied to the buffers at once
+    template <typename Mask>
+    struct LineWorker {
+        OneLineSolver<Mask> solver;
+        std::vector<std::vector<Mask>> block_cells;
+        // The cells changed by the last line solve
+        std::vector<int> changed_cells;
+        // The crossing lines to be queued and if their cell is known, they
+        // are kept when the worker runs on the thread pool
+        std::vector<std::pair<int, bool>> pushes;
+    };
+
+    // The state of the line solving, every search thread has its own one
+    template <typename Mask>
+    struct Propagation {
+        // The first worker solves the lines when there is no thread pool,
+        // the others are used by the pool
+        std::vector<LineWorker<Mask>> workers;
+        LineScheduler::Heuristic heuristic;
+        LineScheduler scheduler;
+        // The count of UpdateState() calls of the line solver
+        int64_t line_solves = 0;
+
+        // The count of the workers used by the current puzzle, the others
+        // are kept for the bigger puzzles
+        int worker_count = 1;
+
+        // Used to solve the half-sweeps of big puzzles on several threads if
+        // parallel is set, the pool is kept for the next puzzles
+        std::unique_ptr<ThreadPool> pool;
+        bool parallel = false;
+        // The lines of the half-sweep, their unknown cells counts and the
+        // results of the solving
+        std::vector<int> sweep_lines;
+        std::vector<int> sweep_unknown;
+        std::vector<int8_t> sweep_solved;
+    };
+
+    // A state of the search, the color of the cell (row, col) is guessed.
+    // The root state has row = -1
+    template <typename Mask>
+    struct SearchNode {
+        std::vector<Mask> cells;
+        int row;
+        int col;
+        int color;
+        int depth;
+    };
+
+    // The search data shared by the threads, defined in puzzle.cpp
+    template <typename Mask>
+    struct SearchState;
+
+    // Returns the config of the last solved puzzle without its cells
+    const Description& solved_description() const;
+
+    template <typename Mask>
+    void GetMaskCells(int& rows, int& columns,
+            std::vector<int>& colors) const;
 
-    void DrawImage();
+    // Solves the read puzzle with the cells of the Mask type
+    template <typename Mask>
+    bool SolveMasks();
 
-    bool UpdateState(OneLineSolver& solver, std::vector<int8_t>& dead_rows,
-            std::vector<int8_t>& dead_cols);
+    // The puzzles with less cells are solved on one thread, the others
+    // solve the half-sweeps in parallel
+    const int kMinParallelSweepCells = 200 * 200;
 
-    bool UpdateGroupsState(OneLineSolver& solver, std::vector<int8_t>& dead,
-        std::vector<std::vector<std::pair<int, int>>>& groups,
-        std::vector<std::vector<int>>& masks);
+    // The count of the lines of a half-sweep copied to the buffers at once
+    const int kSweepBlockLines = 16;
+
+    // The deadline is checked every this count of line solves, and before
+    // every half-sweep and every search node
+    const int kDeadlineCheckSolves = 64;
+
+    // Returns true if the deadline has passed, may be called by several
+    // threads
+    bool OutOfTime();
+
+    // Inits the line worker from the options
+    template <typename Mask>
+    bool InitLineWorker(const Config<Mask>& config, LineWorker<Mask>& worker);
+
+    // Inits the first line worker and the heuristic from the options
+    template <typename Mask>
+    bool InitPropagation(const Config<Mask>& config,
+            Propagation<Mask>& propagation);
+
+    // Starts the threads of the parallel half-sweeps if the puzzle is big
+    // enough and the lines are solved by sweeps
+    template <typename Mask>
+    bool InitParallelSweeps(const Config<Mask>& config,
+            Propagation<Mask>& propagation);
+
+    template <typename Mask>
+    void DrawImage(const Config<Mask>& config);
+
+    // Solves the lines chosen by the scheduler until there are no queued
+    // lines, copies the changed cells to the crossing lines and queues them.
+    // If quiet is set, doesn't draw and doesn't log the contradictions, then
+    // it may be called by several threads
+    template <typename Mask>
+    bool UpdateState(Config<Mask>& config, Propagation<Mask>& propagation,
+            bool quiet = false);
+
+    // Does the same as UpdateState() with the sweep heuristic, but takes
+    // the whole half-sweep and solves it on the thread pool of the
+    // propagation, if any. The lines of a half-sweep don't cross, so the
+    // order of solving them doesn't change the result
+    template <typename Mask>
+    bool UpdateStateSweeps(Config<Mask>& config,
+            Propagation<Mask>& propagation, bool quiet);
+
+    // Guesses the colors of the unknown cells after the line solving has
+    // stopped, the branches are explored by a work-stealing thread pool.
+    // Stops when max_solutions are found, returns the count of the found
+    // solutions (or -1 if the solvers can't be inited) and puts the first
+    // one to the config
+    template <typename Mask>
+    int Search(Config<Mask>& config, int max_solutions);
+
+    // Solves the lines of the node after the guess, then branches on the
+    // unknown cell with the least colors
+    template <typename Mask>
+    void SearchStep(SearchState<Mask>& state,
+            std::shared_ptr<SearchNode<Mask>> node, int worker);
 
-    // Updates cell values (both row and columns) and returns its sum
-    int64_t UpdateCellValues();
     // Checks that the solution was unique
-    bool CheckUniqieness();
+    template <typename Mask>
+    bool CheckUniqieness(const Config<Mask>& config);
 
-    // Used to read vertical and horizontal colored groups
-    std::vector<std::vector<std::pair<int, int>>> ReadGroupInfoColored(
-            std::ifstream& fin, std::map<Color, int>& color_map, int length);
+    // Resizes the groups to the count of the lines, the vectors of the
+    // removed lines are moved to the spare ones and back in the same order,
+    // so every line keeps the memory of its longest groups
+    void ResizeGroups(int length,
+            std::vector<std::vector<std::pair<int, int>>>& groups,
+            std::vector<std::vector<std::pair<int, int>>>& spare);
+    // Copies the puzzle to another description, the vectors of the lines
+    // keep their capacity like the ones of ResizeGroups()
+    void CopyDescription(const Description& from, Description& to);
+    // Used to read vertical and horizontal colored groups of the lines of
+    // line_length cells, the colors are taken from the description. Return
+    // false if can't read them or they can't be in such lines
+    bool ReadGroupInfoColored(TextScanner& scanner, int length,
+            int line_length,
+            std::vector<std::vector<std::pair<int, int>>>& groups,
+            std::vector<std::vector<std::pair<int, int>>>& spare);
     // Used to read vertical and horizontal black and white groups
-    std::vector<std::vector<std::pair<int, int>>> ReadGroupInfoBlack(
-            std::ifstream& fin, int length);
+    bool ReadGroupInfoBlack(TextScanner& scanner, int length,
+            int line_length,
+            std::vector<std::vector<std::pair<int, int>>>& groups,
+            std::vector<std::vector<std::pair<int, int>>>& spare);
+
     // Used to manage multi-image output
     int image_count_;
 
-    Config config_;
+    // The count of UpdateState() calls of the line solver, with the search
+    int64_t line_solves_ = 0;
+
+    // The count of the solutions, see solution_count()
+    int solution_count_ = -1;
+
+    // The color count of the last solved puzzle, it gives the mask type of
+    // its config in the context
+    int solved_color_count_ = 0;
+
+    SolveOptions options_;
+
+    // Draws the images of the puzzle, created by the first image
+    std::unique_ptr<Paint> paint_;
+
+    // See SetDeadline(), there is no deadline by default
+    std::chrono::steady_clock::time_point deadline_ =
+        std::chrono::steady_clock::time_point::max();
+    std::atomic<bool> timed_out_{false};
+
+    // Used if the context isn't given to the constructor
+    std::unique_ptr<SolverContext> own_context_;
+    SolverContext* context_;
+};
+
+// The puzzle is read to the description, then it's copied to the config of
+// its mask type, so the vectors of the previous puzzles are reused. The
+// line solvers and the scheduler only grow their buffers, so they allocate
+// the memory only for a bigger puzzle than the previous ones
+struct Puzzle::SolverContext {
+    template <typename Mask>
+    struct MaskState {
+        Config<Mask> config;
+        Propagation<Mask> propagation;
+    };
+
+    template <typename Mask>
+    MaskState<Mask>& masks() {
+        return std::get<MaskState<Mask>>(mask_states);
+    }
+
+    Description description;
+    // The pairs of the color values and the color indices, -1 is a free
+    // pair (see BuildColorTable())
+    std::vector<std::pair<int, int>> color_table;
+    std::tuple<MaskState<uint8_t>, MaskState<uint16_t>, MaskState<uint32_t>,
+            MaskState<uint64_t>> mask_states;
 };
 
 #endif  // NONOGRAMS_PUZZLE_H_
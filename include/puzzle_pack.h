@@ -0,0 +1,133 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_PUZZLE_PACK_H_
+#define NONOGRAMS_PUZZLE_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <mapped_file.h>
+
+// The pack of puzzles (.pzp) keeps the files of a folder in one file, so
+// they are read without opening every file. The numbers have the byte order
+// of the machine which wrote the pack, like the compiled puzzles have.
+//
+// The file is:
+//    the header (PackHeader)
+//    the puzzles - the contents of the files, every one is padded with zeros
+//        to 8 bytes, so the compiled puzzles are aligned
+//    the index - count entries (PackEntry) sorted by the names
+//    the names - the names of the puzzles without separators
+struct PackHeader {
+    // "PZP" and a zero byte
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    // The positions of the index and of the names
+    uint64_t index;
+    uint64_t names;
+};
+
+struct PackEntry {
+    // The position and the size of the puzzle
+    uint64_t offset;
+    uint64_t size;
+    // The position of the name in the names and its length
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+// Reads the puzzles of a pack by the index or by the name.
+//
+// Example:
+//    PuzzlePack pack;
+//    if (pack.Open("puzzles.pzp", true)) {
+//        int index = pack.Find("cat.pzl");
+//        const char* data;
+//        size_t size;
+//        pack.Load(index, buffer, data, size);
+//        ...
+//    }
+class PuzzlePack {
+ public:
+    PuzzlePack() = default;
+    ~PuzzlePack();
+
+    PuzzlePack(const PuzzlePack&) = delete;
+    PuzzlePack& operator=(const PuzzlePack&) = delete;
+
+    // The mapped pack is read in place, otherwise the index is read to the
+    // memory and the puzzles are read by Load(). Returns false if the pack
+    // can't be opened or is broken
+    bool Open(const std::string& filename, bool mapped);
+
+    void Close();
+
+    bool is_open() const {
+        return open_;
+    }
+
+    int size() const {
+        return count_;
+    }
+
+    std::string name(int index) const;
+
+    // The size of the puzzle in the pack
+    size_t puzzle_size(int index) const {
+        return entries_[index].size;
+    }
+
+    // Returns the index of the puzzle with this name, or -1
+    int Find(const std::string& name) const;
+
+    // Points the data to the puzzle, it's in the mapped pack or it's read
+    // to the buffer. The buffer only grows, so the puzzles read one by one
+    // allocate the memory only for a bigger puzzle. Thread-safe
+    bool Load(int index, std::vector<char>& buffer, const char*& data,
+            size_t& size) const;
+
+    // Writes the files of the folder to the pack sorted by their names,
+    // returns false if a file can't be read or the pack can't be written
+    bool Write(const std::string& filename,
+            const std::string& path_to_puzzles,
+            std::vector<std::string> files) const;
+
+    // Checks if the file has the extension of the packs
+    static bool IsPack(const std::string& filename);
+    static const char* kExtension;
+
+ private:
+    const uint32_t kVersion = 1;
+    // The puzzles and the index start at the multiples of this
+    const size_t kAlignment = 8;
+
+    // Checks the index and the names, they are pointed to by entries_ and
+    // names_, the puzzles end before the index
+    bool CheckIndex(uint64_t index, size_t names_size) const;
+
+    // Compares the name of the puzzle with the given one like strcmp()
+    int CompareName(int index, const char* name, size_t length) const;
+
+    // Reads the bytes of the pack which isn't mapped
+    bool ReadAt(uint64_t offset, void* data, size_t size) const;
+
+    // Used if the pack is mapped
+    MappedFile file_;
+
+    // Used if the pack isn't mapped
+    int fd_ = -1;
+    std::vector<PackEntry> index_;
+    std::vector<char> names_buffer_;
+
+    bool open_ = false;
+    int count_ = 0;
+    const PackEntry* entries_ = nullptr;
+    const char* names_ = nullptr;
+};
+
+#endif  // NONOGRAMS_PUZZLE_PACK_H_
@@ -0,0 +1,75 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_SOLVE_OPTIONS_H_
+#define NONOGRAMS_SOLVE_OPTIONS_H_
+
+#include <string>
+
+#include <image_writer.h>
+#include <line_cache.h>
+#include <line_scheduler.h>
+#include <one_line_solver.h>
+
+// The images drawn by Paint while a puzzle is solved
+struct DrawOptions {
+    // No images are drawn unless it's set
+    bool enabled = false;
+    // The images are written to the files with this prefix
+    std::string image_name = "result";
+    // The size of a cell (in pixels), 0 is 1 pixel for the plain images
+    // and 2 for the cool ones
+    int scale = 0;
+    // The format of the written images, the gifs are always written by
+    // ImageMagick
+    ImageFormat format = ImageFormat::kPng;
+    // Draw the images of every step or of every line solve
+    bool moves = false;
+    bool extra_moves = false;
+    // Push the images to the frames of a gif, the delays are in ms
+    bool gif = false;
+    int gif_frame_delay = 100;
+    int gif_end_delay = 1000;
+    // Draw the groups of the lines beside the cells
+    bool cool = false;
+    // Only log the images instead of writing them
+    bool empty = false;
+    // Display the images instead of writing them
+    bool display = false;
+    // The threads drawing the bands of the rows of the big images
+    int threads = 1;
+};
+
+// The options of solving a puzzle. The solver reads nothing else, so the
+// puzzles with different options may be solved at once in one process.
+// The command line gives them with cli_args::GetSolveOptions()
+struct SolveOptions {
+    // The puzzles which aren't compiled are read as white-black ones
+    bool black = false;
+
+    // The white-black lines are solved by the bitset engine unless the
+    // engine is set
+    bool line_solver_set = false;
+    LineSolverEngine line_solver = LineSolverEngine::kRecursive;
+    // Solve the lines with unknown cells by the overlap of the groups first
+    bool overlap = true;
+    LineScheduler::Heuristic heuristic = LineScheduler::Heuristic::kSweep;
+    // The solved lines are shared through the cache if it's given, it's used
+    // by several threads
+    LineCache* line_cache = nullptr;
+
+    // Guess the cells when the lines can't be solved further
+    bool search = false;
+    // Count the solutions up to the limit with the search, 0 is not counting
+    int count_solutions = 0;
+    // The threads of the search and of the sweeps of the big puzzles, 0 is
+    // the count of the hardware threads. The puzzles solved at once by
+    // several jobs take one thread each unless the threads are set
+    bool threads_set = false;
+    int threads = 0;
+
+    DrawOptions draw;
+};
+
+#endif  // NONOGRAMS_SOLVE_OPTIONS_H_
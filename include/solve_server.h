@@ -0,0 +1,122 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_SOLVE_SERVER_H_
+#define NONOGRAMS_SOLVE_SERVER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <solve_options.h>
+#include <stream_solver.h>
+#include <thread_pool.h>
+
+// The protocol of the server. The numbers have the byte order of the
+// machine, the socket is local.
+//
+// A request is the header followed by size bytes of the puzzle in the .pzl
+// format (white-black with --black of the server). A response is its size
+// (uint32_t) followed by the JSON result of the stream (see
+// stream_solver.h) without the line break. The puzzle number of the result
+// is the number of the request in its connection starting from 1, the
+// responses of a connection may come in another order than the requests.
+struct RequestHeader {
+    uint32_t size;
+    // The time limit of the puzzle (in ms) counted from its arrival, 0 is
+    // the timeout of the server
+    uint32_t timeout;
+};
+
+// Solves the puzzles coming to a Unix socket on a fixed set of workers,
+// every worker keeps its own solver buffers between the requests.
+//
+// One thread reads the requests of all the connections. When the count of
+// the requests queued and solved reaches max_in_flight, it stops reading
+// the sockets until a request is done, so the clients are blocked by the
+// socket buffers. The workers write the responses themselves.
+//
+// Example:
+//    SolveServer server(4, 64, 0);
+//    server.Run("/tmp/nonograms.sock", options);
+class SolveServer {
+ public:
+    // The count of the workers (0 is the count of the hardware threads),
+    // the max count of the requests queued and solved, and the time limit
+    // of a puzzle (in ms, 0 is no limit) unless its request has one
+    SolveServer(int jobs, int max_in_flight, int timeout);
+
+    // Serves until SIGINT or SIGTERM, the puzzles are solved with the
+    // options without the images. Returns false if the socket can't be
+    // created
+    bool Run(const std::string& socket_path, const SolveOptions& options);
+
+    // The blocking helpers of the clients. Return -1 if can't connect
+    static int Connect(const std::string& socket_path);
+    // Return false if the connection is broken
+    static bool SendRequest(int fd, const char* data, size_t size,
+            uint32_t timeout);
+    static bool ReceiveResponse(int fd, std::string& response);
+
+ private:
+    struct Connection;
+
+    // The largest request read, a bigger one closes its connection
+    const uint32_t kMaxRequestSize = 64 << 20;
+    // The bytes read from a socket at once
+    const size_t kReadChunk = 64 << 10;
+    // The connections waiting for accept()
+    const int kListenBacklog = 64;
+    // The time a worker waits for a client reading its response (in
+    // seconds), then the connection is closed
+    const int kSendTimeout = 10;
+
+    // Creates the listening socket, removes the stale socket file
+    bool Listen(const std::string& socket_path);
+
+    // Accepts the waiting connections
+    void Accept();
+
+    // Reads the bytes waiting in the socket, marks the connection closed at
+    // the end of the stream or on an error
+    void Receive(Connection& connection);
+
+    // Queues the complete requests of the connection while the limit
+    // allows, returns false if the connection sent a broken request
+    bool Dispatch(const std::shared_ptr<Connection>& connection);
+
+    // Checks if a complete request is received and not queued yet
+    bool HasRequest(const Connection& connection) const;
+
+    // Solves the request on the worker and sends the response
+    void Solve(const std::shared_ptr<Connection>& connection, int number,
+            const std::string& request, StreamSolver::Deadline deadline,
+            int worker);
+
+    // Wakes the thread reading the sockets
+    void Wake();
+
+    int listen_fd_ = -1;
+    // A pipe written by the workers and the signals to wake the thread
+    // reading the sockets
+    int wake_fds_[2] = {-1, -1};
+
+    std::vector<std::shared_ptr<Connection>> connections_;
+
+    std::unique_ptr<ThreadPool> pool_;
+    std::vector<std::unique_ptr<StreamSolver>> solvers_;
+    // The results written by the workers
+    std::vector<std::string> results_;
+
+    int jobs_;
+    int max_in_flight_;
+    int timeout_;
+    std::atomic<int> in_flight_{0};
+};
+
+#endif  // NONOGRAMS_SOLVE_SERVER_H_
@@ -0,0 +1,80 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_STREAM_SOLVER_H_
+#define NONOGRAMS_STREAM_SOLVER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <puzzle.h>
+#include <solve_options.h>
+
+// Solves the puzzles coming one by one in a text stream and writes a JSON
+// line with the result of every puzzle, the solver buffers are reused.
+//
+// The puzzles are in the .pzl format (white-black ones if the options are
+// black), a puzzle ends with a line "---" or with the end of the stream. A
+// result looks like:
+//    {"puzzle":1,"solved":true,"rows":2,"columns":3,"grid":"2 1 4 0",
+//        "line_solves":5,"time":0.0001}
+// where the grid is the runs of the cells in the row-major order, every run
+// is its length and its color index (0 is white). An unsolved puzzle has
+// no sizes and no grid, it has "timed_out":true if it's out of time and
+// "error" with the message if the solver has failed on it. With
+// --count-solutions the result has "solutions" with the count of the found
+// solutions (the limit means there may be more), the first one is the grid.
+//
+// Example:
+//    StreamSolver solver(options);
+//    solver.Run(std::cin, std::cout, 0);
+class StreamSolver {
+ public:
+    typedef std::chrono::steady_clock::time_point Deadline;
+
+    // The puzzles are solved with the options, the images are drawn only
+    // if they are enabled
+    explicit StreamSolver(const SolveOptions& options);
+
+    // Solves the puzzles until the end of the input, every one has the time
+    // limit (in ms, 0 is no limit). Returns false if the output can't be
+    // written
+    bool Run(std::istream& in, std::ostream& out, int timeout);
+
+    // Solves the puzzle until the deadline and puts its result to the line
+    // (without the line break), the number of the puzzle goes to the result
+    void SolveRecord(int number, const char* data, size_t size,
+            Deadline deadline, std::string& result);
+
+    // Returns the deadline of a puzzle starting now with the time limit (in
+    // ms), 0 is no limit
+    static Deadline GetDeadline(int timeout);
+
+ private:
+    // Puts the result of the solved (or unsolved) puzzle to the line
+    void WriteResult(int number, const Puzzle& puzzle, bool solved,
+            double time, std::string& result);
+    // Puts the error of the puzzle which has failed the solver to the line
+    void WriteError(int number, const char* error, double time,
+            std::string& result);
+    // Appends the solving time and ends the line
+    static void AppendTime(double time, std::string& result);
+
+    // The line ending a puzzle in the stream
+    const char* kSeparator = "---";
+
+    SolveOptions options_;
+
+    Puzzle::SolverContext context_;
+    // The colors of the cells of the solved puzzle
+    std::vector<int> cells_;
+    // The name of the puzzle in the logs
+    std::string name_;
+};
+
+#endif  // NONOGRAMS_STREAM_SOLVER_H_
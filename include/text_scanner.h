@@ -0,0 +1,87 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_TEXT_SCANNER_H_
+#define NONOGRAMS_TEXT_SCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Reads the numbers and the words separated by whitespace from a text in the
+// memory, like the >> operator of std::istream, but without the locales and
+// the copies of the words. The text isn't owned by the scanner.
+//
+// Example:
+//    TextScanner scanner(text, size);
+//    int n, m;
+//    if (!scanner.ReadInt(n) || !scanner.ReadInt(m)) { ... }
+class TextScanner {
+ public:
+    TextScanner(const char* data, size_t size)
+        : pos_(data), end_(data + size) {}
+
+    // Reads a decimal number with an optional sign, returns false if there
+    // is no number or it doesn't fit in int
+    bool ReadInt(int& value) {
+        SkipSpaces();
+        const char* pos = pos_;
+        bool negative = pos < end_ && *pos == '-';
+        if (pos < end_ && (*pos == '-' || *pos == '+')) {
+            pos++;
+        }
+        if (pos == end_ || !IsDigit(*pos)) {
+            return false;
+        }
+        int64_t result = 0;
+        for (; pos < end_ && IsDigit(*pos); pos++) {
+            result = result * 10 + (*pos - '0');
+            if (result > kMaxValue) {
+                return false;
+            }
+        }
+        value = negative ? -result : result;
+        pos_ = pos;
+        return true;
+    }
+
+    // Points the word to the next characters up to a whitespace, returns
+    // false at the end of the text
+    bool ReadWord(const char*& word, size_t& length) {
+        SkipSpaces();
+        if (pos_ == end_) {
+            return false;
+        }
+        word = pos_;
+        while (pos_ < end_ && !IsSpace(*pos_)) {
+            pos_++;
+        }
+        length = pos_ - word;
+        return true;
+    }
+
+ private:
+    // Used to fail on the numbers greater than int has, -2^31 isn't read
+    const int64_t kMaxValue = std::numeric_limits<int>::max();
+
+    static bool IsDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // The same characters as std::isspace() has in the "C" locale
+    static bool IsSpace(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    void SkipSpaces() {
+        while (pos_ < end_ && IsSpace(*pos_)) {
+            pos_++;
+        }
+    }
+
+    const char* pos_;
+    const char* end_;
+};
+
+#endif  // NONOGRAMS_TEXT_SCANNER_H_
@@ -0,0 +1,100 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#ifndef NONOGRAMS_THREAD_POOL_H_
+#define NONOGRAMS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs tasks on a fixed set of threads with work stealing.
+//
+// Every worker has its own queue. A task submitted by a worker goes to the
+// back of the worker's queue, and the worker takes the tasks from the back,
+// so it goes depth-first. An idle worker steals from the front of the other
+// queues, where the oldest (usually the biggest) tasks are.
+//
+// Every task gets the index of the worker running it, so the workers may
+// keep their own state.
+//
+// Example:
+//    ThreadPool pool(4);
+//    pool.Submit([](int worker) { ... });
+//    pool.Wait();
+class ThreadPool {
+ public:
+    typedef std::function<void(int)> Task;
+
+    // 0 threads means the count of the hardware threads
+    explicit ThreadPool(int thread_count);
+    ~ThreadPool();
+
+    int thread_count() const {
+        return threads_.size();
+    }
+
+    // Adds a task, it goes to the queue of the current worker if called
+    // from a task of this pool, or to the queues in turn otherwise (also
+    // from a task of another pool)
+    void Submit(Task task);
+
+    // Waits until all the submitted tasks are done
+    void Wait();
+
+    // The count of the tasks taken from the queues of the other workers
+    int64_t steals() const {
+        return steals_;
+    }
+
+ private:
+    // The tasks are kept in a ring buffer, it grows when it's full and
+    // doesn't shrink, so the warmed-up queues don't allocate the memory
+    struct Queue {
+        // The first size of the buffer
+        const size_t kMinSize = 16;
+
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head = 0;
+        size_t size = 0;
+
+        void PushBack(Task task);
+        void PopBack(Task& task);
+        void PopFront(Task& task);
+    };
+
+    void WorkerLoop(int worker);
+
+    // Takes a task from the own queue or steals it, returns false if all
+    // the queues are empty
+    bool TakeTask(int worker, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    // Guards the counters below, used to sleep when there are no tasks
+    std::mutex mutex_;
+    std::condition_variable task_added_;
+    std::condition_variable all_done_;
+    // The tasks in the queues, and the tasks not finished yet
+    int queued_ = 0;
+    int pending_ = 0;
+    bool stop_ = false;
+
+    std::atomic<int> next_queue_;
+    std::atomic<int64_t> steals_;
+
+    // The pool and the index of the worker of the current thread, nullptr
+    // and -1 for other threads
+    static thread_local const ThreadPool* current_pool_;
+    static thread_local int current_worker_;
+};
+
+#endif  // NONOGRAMS_THREAD_POOL_H_
@@ -0,0 +1,65 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <allocation_counter.h>
+
+#include <cstdlib>
+#include <new>
+
+using std::bad_alloc;
+using std::nothrow_t;
+
+static thread_local int64_t thread_allocations = 0;
+
+int64_t ThreadAllocations() {
+    return thread_allocations;
+}
+
+// All the replaceable forms are replaced, so every block is freed by the
+// same allocator which made it
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    thread_allocations++;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size) {
+    void* ptr = operator new(size, std::nothrow);
+    if (!ptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
@@ -2,9 +2,15 @@
  * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
  * This code is released under the license described in the LICENSE file
  */
+#include <arguments.h>
+
 #include <string>
 
 #include <args.hxx>
+#include <image_writer.h>
+#include <line_cache.h>
+#include <line_scheduler.h>
+#include <one_line_solver.h>
 
 
 namespace cli_args {
@@ -13,7 +19,26 @@ args::ArgumentParser parser("This is a nonogram solver program.");
 args::HelpFlag help(parser, "help", "Display help", {'h', "help"});
 
 args::ValueFlag<std::string> inputPuzzle(parser, "path_to_puzzle",
-        "Solve a puzzle", {'i', "input"});
+        "Solve a puzzle or the puzzles of a pack", {'i', "input"});
+
+args::Flag stream(parser, "stream",
+        "Solve the puzzles coming to stdin (every one ends with a line \"---\")"
+        " and write the results to stdout as JSON lines, the images are drawn "
+        "only with -o", {"stream"});
+
+args::ValueFlag<std::string> serve(parser, "path_to_socket",
+        "Solve the puzzles coming to this Unix socket on the workers (-j) "
+        "until SIGINT or SIGTERM, see solve_server.h for the protocol",
+        {"serve"});
+
+args::ValueFlag<int> max_in_flight(parser, "requests",
+        "The max count of the requests queued and solved by the server, it "
+        "stops reading the sockets when the count is reached",
+        {"max-in-flight"}, 64);
+
+args::ValueFlag<int> timeout(parser, "ms",
+        "The time limit of a puzzle of the stream or of the server (in ms), 0 "
+        "is no limit", {"timeout"}, 0);
 
 args::ValueFlag<std::string> inputImage(parser, "path_to_image",
         "Convert an image to the puzzle", {'p', "in-image"});
@@ -25,8 +50,38 @@ args::ValueFlag<std::string> imageName(parser, "image_name",
 args::ValueFlag<int> scaleImage(parser, "scale_factor",
         "The scale factor of the result image", {'s', "scale"}, 2);
 
+args::ValueFlag<std::string> image_format(parser, "format",
+        "The format of the images: \"png\" or \"ppm\" written by the "
+        "program, or \"magick\" (png written by ImageMagick, smaller but "
+        "slower)", {"image-format"}, "png");
+
+args::Flag compile(parser, "compile",
+        "Convert the puzzle (-i) or the image (-p) to the binary format, the "
+        "file gets the .pzb extension", {"compile"});
+
 args::ValueFlag<std::string> benchmark(parser, "path_to_puzzles",
-        "Launch a benchmark", {'x', "benchmark"});
+        "Launch a benchmark on a folder or a pack", {'x', "benchmark"});
+
+args::ValueFlag<std::string> make_pack(parser, "path_to_pack",
+        "Write the puzzles of the benchmark folder (-x) to a pack file (.pzp) "
+        "instead of solving them", {"make-pack"});
+
+args::ValueFlag<std::string> pack_puzzle(parser, "name",
+        "Solve only the puzzle with this name of the pack (-i)",
+        {"puzzle"});
+
+args::Flag no_mmap(parser, "no_mmap",
+        "Read the puzzles of a pack by pread() instead of mapping the pack",
+        {"no-mmap"});
+
+args::ValueFlag<std::string> load_test(parser, "path_to_socket",
+        "Send the puzzles of the benchmark (-x) to the server on this socket "
+        "from -j connections and measure the latency", {"load-test"});
+
+args::ValueFlag<int> jobs(parser, "jobs",
+        "The count of the puzzles solved at once by the benchmark or by the "
+        "server, or the connections of --load-test (0 is the count of the "
+        "hardware threads)", {'j', "jobs"}, 1);
 
 args::ValueFlag<int> gif_frame_delay(parser, "gif_frame_delay",
         "Delay between frames in the gif image (in ms)",
@@ -36,6 +91,49 @@ args::ValueFlag<int> gif_end_delay(parser, "gif_end_delay",
         "The last frame delay in the gif image (in ms)",
         {"ged", "gif-end-delay"}, 1000);
 
+args::ValueFlag<std::string> line_solver(parser, "engine",
+        "The line solver engine - iterative, recursive or bitset (the default "
+        "for white-black puzzles)", {"line-solver"}, "recursive");
+
+args::Flag line_benchmark(parser, "line_benchmark",
+        "Compare the line solver engines on random lines",
+        {"line-benchmark"});
+
+args::ValueFlag<int> line_cache(parser, "megabytes",
+        "Remember the solved lines in a cache of this size (in MB)",
+        {"line-cache"}, 0);
+
+args::ValueFlag<std::string> heuristic(parser, "heuristic",
+        "The order of solving the lines - sweep, fixed, slack or unknown",
+        {"heuristic"}, "sweep");
+
+args::Flag compare_heuristics(parser, "compare_heuristics",
+        "Run the benchmark with every heuristic and compare them",
+        {"compare-heuristics"});
+
+args::Flag parse_benchmark(parser, "parse_benchmark",
+        "Only read the puzzles of the benchmark several times and measure the "
+        "parsing speed", {"parse-benchmark"});
+
+args::Flag no_overlap(parser, "no_overlap",
+        "Don't solve the lines with unknown cells by the overlap of the groups",
+        {"no-overlap"});
+
+args::Flag search(parser, "search",
+        "Guess the colors of the cells when the lines can't be solved further "
+        "and return the first solution found", {"search"});
+
+args::ValueFlag<int> threads(parser, "threads",
+        "The count of the threads of the search and of the line sweeps of big "
+        "puzzles (the default is the count of the hardware threads, or 1 "
+        "with several jobs)",
+        {"threads"}, 0);
+
+args::ValueFlag<int> count_solutions(parser, "limit",
+        "Count the solutions with the search, stop when this count is found "
+        "(2 is enough to prove the uniqueness), uses a 64 MB line cache by "
+        "default", {"count-solutions"}, 0);
+
 args::Flag black(parser, "black",
         "Solve white-black puzzle (the default is colored)",
         {'b', "black"});
@@ -56,4 +154,49 @@ args::Flag empty(parser, "empty", "Don't save the image of the puzzle",
 
 args::Flag display(parser, "display", "Display the image instead of writing to"
         " file", {'d', "display"});
+
+args::ValueFlag<int> draw_threads(parser, "threads",
+        "The count of the threads drawing the bands of the big images",
+        {"draw-threads"}, 1);
+
+args::Flag async_log(parser, "async_log",
+        "Format and write the log messages on a separate thread",
+        {"async-log"});
+
+bool GetSolveOptions(SolveOptions& options) {
+    options = SolveOptions();
+    options.black = black;
+    options.line_solver_set = line_solver;
+    if (!ParseLineSolverEngine(args::get(line_solver), options.line_solver) ||
+            !LineScheduler::ParseHeuristic(args::get(heuristic),
+                options.heuristic)) {
+        return false;
+    }
+    options.overlap = !no_overlap;
+    if (LineCache::get()->Enabled()) {
+        options.line_cache = LineCache::get();
+    }
+    options.search = search;
+    options.count_solutions = args::get(count_solutions);
+    options.threads_set = threads;
+    options.threads = args::get(threads);
+
+    DrawOptions& draw = options.draw;
+    draw.enabled = true;
+    draw.image_name = args::get(imageName);
+    draw.scale = scaleImage ? args::get(scaleImage) : 0;
+    if (!ParseImageFormat(args::get(image_format), draw.format)) {
+        return false;
+    }
+    draw.moves = moves;
+    draw.extra_moves = extra_moves;
+    draw.gif = gif;
+    draw.gif_frame_delay = args::get(gif_frame_delay);
+    draw.gif_end_delay = args::get(gif_end_delay);
+    draw.cool = cool;
+    draw.empty = empty;
+    draw.display = display;
+    draw.threads = args::get(draw_threads);
+    return true;
+}
 }  // namespace cli_args
@@ -5,32 +5,71 @@
 #include <benchmark.h>
 
 #include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <functional>
-#include <set>
+#include <random>
+#include <sstream>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <allocation_counter.h>
 #include <args.hxx>
 #include <arguments.h>
+#include <line_cache.h>
 #include <logger.h>
+#include <mapped_file.h>
+#include <one_line_solver.h>
 #include <puzzle.h>
+#include <puzzle_pack.h>
+#include <solve_server.h>
+#include <thread_pool.h>
 #include <timespan.h>
 
+using std::atomic;
 using std::greater;
 using std::max;
+using std::min;
+using std::mt19937;
 using std::pair;
-using std::set;
 using std::string;
+using std::stringstream;
+using std::thread;
+using std::uniform_int_distribution;
+using std::uniform_real_distribution;
 using std::vector;
 
-bool Benchmark::Run(const string& path_to_puzzles) {
-    Logger::get()->info("Starting a benchmark...");
+// The heap allocations of the current thread, they are counted only by
+// nonograms_benchmark (see allocation_counter.h)
+static int64_t CountAllocations() {
+#ifdef NONOGRAMS_COUNT_ALLOCATIONS
+    return ThreadAllocations();
+#else
+    return 0;
+#endif
+}
+
+bool Benchmark::ListFiles(const string& path_to_puzzles,
+        vector<string>& files) {
+    if (PuzzlePack::IsPack(path_to_puzzles)) {
+        if (!pack_.Open(path_to_puzzles, !cli_args::no_mmap)) {
+            Logger::get()->error("Failed to open the pack {}",
+                    path_to_puzzles);
+            return false;
+        }
+        for (int i = 0; i < pack_.size(); i++) {
+            files.push_back(pack_.name(i));
+        }
+        return true;
+    }
 
     // Access all entry names
     DIR* dir = opendir(path_to_puzzles.c_str());
-    vector<string> files;
     if (dir) {
         dirent* entry = readdir(dir);
         while (entry) {
@@ -46,69 +85,575 @@ bool Benchmark::Run(const string& path_to_puzzles) {
                 " the path?");
         return false;
     }
+    closedir(dir);
+    return true;
+}
+
+Benchmark::Benchmark(const SolveOptions& options) : options_(options) {}
+
+bool Benchmark::RunPuzzle(Puzzle& puzzle, const string& path,
+        const string& file, bool solve, vector<char>& buffer) {
+    if (!pack_.is_open()) {
+        return solve ? puzzle.Solve(path) : puzzle.Read(path);
+    }
+    const char* data;
+    size_t size;
+    int index = pack_.Find(file);
+    if (index < 0 || !pack_.Load(index, buffer, data, size)) {
+        return false;
+    }
+    return solve ? puzzle.Solve(file, data, size) :
+        puzzle.Read(file, data, size);
+}
 
-    // The set of running times of the slowest files
-    set<pair<double, string>, greater<pair<double, string>>> top_set;
-    vector<double> all_running_times;
+bool Benchmark::SolveFile(const string& path_to_puzzles, const string& file,
+        Puzzle::SolverContext& context, vector<char>& buffer,
+        RunStats& stats) {
+    LOG_DEBUG("Solving... {}", file);
+    string path = path_to_puzzles + file;
 
-    int solved = 0;
-    double time_summary = 0.0;
-    double time_max = 0.0;
+    // Measure running time and the allocations
     Timespan ts;
+    int64_t allocations = CountAllocations();
+    Puzzle puzzle(options_, &context);
+    if (!RunPuzzle(puzzle, path, file, true, buffer)) {
+        Logger::get()->error("Failed benchmark on file {}", file);
+        return false;
+    }
+    allocations = CountAllocations() - allocations;
+    double result = ts.Peek();
 
-    // Disable low-level log messages to more clean output
-    Logger::SetLevel(spdlog::level::warn);
+    // Update statistics
+    stats.running_times.push_back({result, file});
+    stats.line_solves += puzzle.line_solves();
+    stats.allocations += allocations;
+    if (allocations == 0) {
+        stats.files_without_allocations++;
+    }
+    if (puzzle.solution_count() == 0) {
+        stats.no_solutions.push_back(file);
+    } else if (puzzle.solution_count() == 1) {
+        stats.unique_solutions++;
+    } else if (puzzle.solution_count() > 1) {
+        stats.many_solutions.push_back(file);
+    }
+    return true;
+}
 
-    for (const auto& file : files) {
-        Logger::get()->debug("Solving... {}", file);
-
-        // Write the progress of the benchmark
-        // Warning - disabled at line 40
-        if (solved > 0) {
-            Logger::get()->info("PROGRESS: {}%, AVERAGE TIME: {}, MAX TIME: {},"
-                    " solving puzzle {}",
-                    static_cast<double>(solved)
-                        / static_cast<double>(files.size()) * 100.0,
-                    time_summary / static_cast<double>(solved), time_max, file);
-        }
-
-        // Measure running time
-        ts.Peek();
-        Puzzle puzzle;
-        if (!puzzle.Solve(path_to_puzzles + file)) {
-            Logger::get()->error("Failed benchmark on file {}", file);
+bool Benchmark::Run(const string& path_to_puzzles) {
+    Logger::get()->info("Starting a benchmark...");
+
+    vector<string> files;
+    if (!ListFiles(path_to_puzzles, files)) {
+        return false;
+    }
+    if (cli_args::make_pack) {
+        if (pack_.is_open()) {
+            Logger::get()->error("The pack is made from a folder of puzzles");
             return false;
         }
-        double result = ts.Peek(true);
+        return pack_.Write(args::get(cli_args::make_pack), path_to_puzzles,
+                files);
+    }
+    if (cli_args::load_test) {
+        return RunLoadTest(args::get(cli_args::load_test), path_to_puzzles,
+                files);
+    }
+    if (cli_args::compare_heuristics) {
+        return RunHeuristics(path_to_puzzles, files);
+    }
+    if (cli_args::parse_benchmark) {
+        return RunParser(path_to_puzzles, files);
+    }
 
-        // Update statistics
-        time_summary += result;
-        time_max = max(time_max, result);
-        solved++;
+    // The workers write the images to the same files
+    int jobs = args::get(cli_args::jobs);
+    if (jobs != 1 && !options_.draw.empty) {
+        Logger::get()->error("The benchmark can't write the images with "
+                "several jobs, please add --empty");
+        return false;
+    }
 
-        // Update the top set
-        top_set.insert({result, file});
-        if (top_set.size() > kMaxTopSize) {
-            top_set.erase(*top_set.rbegin());
-        }
+    // The jobs don't solve their puzzles on several threads, unless it's
+    // asked for, otherwise every job would make a thread pool of all the
+    // hardware threads
+    if (jobs != 1 && !options_.threads_set) {
+        options_.threads = 1;
+    }
+
+    // Every worker has its own statistics, they are merged at the end. The
+    // workers reuse their contexts and buffers for all the files
+    vector<RunStats> worker_stats(1);
+    vector<Puzzle::SolverContext> contexts(1);
+    vector<vector<char>> buffers(1);
+    Timespan ts;
+
+    // Disable low-level log messages to more clean output
+    Logger::SetLevel(spdlog::level::warn);
 
-        all_running_times.push_back(result);
+    if (jobs == 1) {
+        for (const auto& file : files) {
+            if (!SolveFile(path_to_puzzles, file, contexts[0], buffers[0],
+                        worker_stats[0])) {
+                return false;
+            }
+        }
+    } else {
+        // The files are spread over the queues of the workers, an idle
+        // worker steals them from the others
+        ThreadPool pool(jobs);
+        jobs = pool.thread_count();
+        worker_stats.resize(jobs);
+        contexts.resize(jobs);
+        buffers.resize(jobs);
+        atomic<bool> failed(false);
+        for (const auto& file : files) {
+            pool.Submit([&, file](int worker) {
+                if (!failed && !SolveFile(path_to_puzzles, file,
+                            contexts[worker], buffers[worker],
+                            worker_stats[worker])) {
+                    failed = true;
+                }
+            });
+        }
+        pool.Wait();
+        if (failed) {
+            return false;
+        }
     }
+    double wall_time = ts.Peek();
 
     // Revert the logger back to the info level
     Logger::SetLevel(spdlog::level::info);
 
-    sort(all_running_times.begin(), all_running_times.end());
+    RunStats stats;
+    for (const auto& it : worker_stats) {
+        stats.running_times.insert(stats.running_times.end(),
+                it.running_times.begin(), it.running_times.end());
+        stats.line_solves += it.line_solves;
+        stats.no_solutions.insert(stats.no_solutions.end(),
+                it.no_solutions.begin(), it.no_solutions.end());
+        stats.unique_solutions += it.unique_solutions;
+        stats.allocations += it.allocations;
+        stats.files_without_allocations += it.files_without_allocations;
+        stats.many_solutions.insert(stats.many_solutions.end(),
+                it.many_solutions.begin(), it.many_solutions.end());
+    }
+    if (stats.running_times.empty()) {
+        Logger::get()->info("There are no puzzles to solve");
+        return true;
+    }
+
+    // The slowest files go first
+    auto& running_times = stats.running_times;
+    sort(running_times.begin(), running_times.end(),
+            greater<pair<double, string>>());
+    double time_summary = 0.0;
+    for (const auto& it : running_times) {
+        time_summary += it.first;
+    }
 
     // Print statistics
     Logger::get()->info("Average time: {}, Median time: {}, Max time: {}",
-            time_summary / static_cast<double>(solved),
-            all_running_times[all_running_times.size() / 2], time_max);
+            time_summary / static_cast<double>(running_times.size()),
+            running_times[running_times.size() / 2].first,
+            running_times[0].first);
+    Logger::get()->info("Wall time: {} seconds with {} jobs", wall_time, jobs);
+    Logger::get()->info("Line solves: {}", stats.line_solves);
+#ifdef NONOGRAMS_COUNT_ALLOCATIONS
+    Logger::get()->info("Heap allocations: {} while solving, {} of {} files "
+            "are solved without them", stats.allocations,
+            stats.files_without_allocations, running_times.size());
+#endif
+    if (options_.count_solutions) {
+        Logger::get()->info("Solutions: {} puzzles are unique, {} have no "
+                "solutions, {} have more solutions", stats.unique_solutions,
+                stats.no_solutions.size(), stats.many_solutions.size());
+        for (const auto& it : stats.no_solutions) {
+            Logger::get()->info("No solutions, file {}", it);
+        }
+        for (const auto& it : stats.many_solutions) {
+            Logger::get()->info("More solutions, file {}", it);
+        }
+    }
 
-    Logger::get()->info("Top {} heaviest nonograms:", top_set.size());
-    for (const auto& it : top_set) {
-        Logger::get()->info("{} seconds, file {}", it.first, it.second);
+    int top_size = min<int>(kMaxTopSize, running_times.size());
+    Logger::get()->info("Top {} heaviest nonograms:", top_size);
+    for (int i = 0; i < top_size; i++) {
+        Logger::get()->info("{} seconds, file {}", running_times[i].first,
+                running_times[i].second);
     }
+    if (options_.line_cache) {
+        options_.line_cache->LogStats();
+    }
+
+#ifdef NONOGRAMS_COUNT_ALLOCATIONS
+    return CheckAllocations(path_to_puzzles, files);
+#else
+    return true;
+#endif
+}
+
+bool Benchmark::CheckAllocations(const string& path_to_puzzles,
+        const vector<string>& files) {
+    // The images, the search and the line cache allocate by design
+    if (!options_.draw.empty || options_.search ||
+            options_.count_solutions || options_.line_cache) {
+        Logger::get()->info("The allocations are checked only for the line "
+                "solving without the images");
+        return true;
+    }
+
+    // The paths are made before, so only the solving is counted
+    vector<string> paths;
+    for (const auto& file : files) {
+        paths.push_back(path_to_puzzles + file);
+    }
+
+    // The first rounds grow the buffers of the context to the biggest
+    // puzzle, the last one must not allocate
+    Puzzle::SolverContext context;
+    vector<char> buffer;
+    Logger::SetLevel(spdlog::level::warn);
+    for (int round = 0; round < kAllocationRounds; round++) {
+        bool last_round = round + 1 == kAllocationRounds;
+        for (int i = 0; i < files.size(); i++) {
+            const string& file = files[i];
+            int64_t allocations = CountAllocations();
+            {
+                Puzzle puzzle(options_, &context);
+                if (!RunPuzzle(puzzle, paths[i], file, true, buffer)) {
+                    Logger::SetLevel(spdlog::level::info);
+                    Logger::get()->error("Failed benchmark on file {}", file);
+                    return false;
+                }
+            }
+            allocations = CountAllocations() - allocations;
+            if (last_round && allocations != 0) {
+                Logger::SetLevel(spdlog::level::info);
+                Logger::get()->error("File {} made {} heap allocations with "
+                        "the buffers of a warmed-up context", file,
+                        allocations);
+                return false;
+            }
+        }
+    }
+    Logger::SetLevel(spdlog::level::info);
+    Logger::get()->info("No heap allocations after {} warm-up rounds",
+            kAllocationRounds - 1);
+    return true;
+}
+
+bool Benchmark::RunHeuristics(const string& path_to_puzzles,
+        const vector<string>& files) {
+    Puzzle::SolverContext context;
+    vector<char> buffer;
+    for (const auto& heuristic : LineScheduler::Heuristics()) {
+        SolveOptions options = options_;
+        options.heuristic = heuristic.first;
+        int64_t line_solves = 0;
+        Timespan ts;
 
+        // Disable low-level log messages to more clean output
+        Logger::SetLevel(spdlog::level::warn);
+        for (const auto& file : files) {
+            Puzzle puzzle(options, &context);
+            if (!RunPuzzle(puzzle, path_to_puzzles + file, file, true,
+                        buffer)) {
+                Logger::get()->error("Failed benchmark on file {}", file);
+                return false;
+            }
+            line_solves += puzzle.line_solves();
+        }
+        double time = ts.Peek();
+        Logger::SetLevel(spdlog::level::info);
+
+        Logger::get()->info("Heuristic {}: {} line solves, {} seconds",
+                heuristic.second, line_solves, time);
+    }
+    return true;
+}
+
+bool Benchmark::RunParser(const string& path_to_puzzles,
+        const vector<string>& files) {
+    vector<string> paths;
+    size_t file_bytes = 0;
+    for (int i = 0; i < files.size(); i++) {
+        paths.push_back(path_to_puzzles + files[i]);
+        struct stat info;
+        if (pack_.is_open()) {
+            file_bytes += pack_.puzzle_size(i);
+        } else if (stat(paths.back().c_str(), &info) == 0) {
+            file_bytes += info.st_size;
+        }
+    }
+
+    // The puzzles are read to the same context, like the files of a
+    // benchmark
+    Puzzle::SolverContext context;
+    Puzzle puzzle(options_, &context);
+    vector<char> buffer;
+    Timespan ts;
+    for (int round = 0; round < kParseRounds; round++) {
+        for (int i = 0; i < files.size(); i++) {
+            if (!RunPuzzle(puzzle, paths[i], files[i], false, buffer)) {
+                Logger::get()->error("Failed benchmark on file {}", files[i]);
+                return false;
+            }
+        }
+    }
+    double time = ts.Peek();
+
+    double megabytes = static_cast<double>(file_bytes) * kParseRounds /
+        (1 << 20);
+    Logger::get()->info("Read {} files {} times: {} MB in {} seconds",
+            files.size(), kParseRounds, megabytes, time);
+    Logger::get()->info("Parsing speed: {} MB/s, {} puzzles/s",
+            megabytes / time, files.size() * kParseRounds / time);
+    return true;
+}
+
+bool Benchmark::RunLoadTest(const string& socket_path,
+        const string& path_to_puzzles, const vector<string>& files) {
+    // The puzzles are read before the test, so it measures only the server
+    vector<string> requests;
+    vector<char> buffer;
+    for (const auto& file : files) {
+        const char* data;
+        size_t size;
+        MappedFile mapped_file;
+        if (pack_.is_open()) {
+            int index = pack_.Find(file);
+            if (!pack_.Load(index, buffer, data, size)) {
+                return false;
+            }
+        } else if (mapped_file.Open(path_to_puzzles + file)) {
+            data = mapped_file.data();
+            size = mapped_file.size();
+        } else {
+            Logger::get()->error("Can't open file {}", path_to_puzzles + file);
+            return false;
+        }
+        requests.push_back(string(data, size));
+    }
+
+    int connections = args::get(cli_args::jobs);
+    if (connections <= 0) {
+        connections = max<int>(1, thread::hardware_concurrency());
+    }
+    uint32_t timeout = max(0, args::get(cli_args::timeout));
+
+    // Every connection has its own thread and statistics
+    vector<vector<double>> latencies(connections);
+    vector<int> solved(connections);
+    vector<int> timed_out(connections);
+    atomic<bool> failed(false);
+    vector<thread> threads;
+    Timespan ts;
+    for (int i = 0; i < connections; i++) {
+        threads.emplace_back([&, i] {
+            int fd = SolveServer::Connect(socket_path);
+            if (fd < 0) {
+                failed = true;
+                return;
+            }
+            string response;
+            for (const auto& request : requests) {
+                Timespan latency;
+                if (!SolveServer::SendRequest(fd, request.data(),
+                            request.size(), timeout) ||
+                        !SolveServer::ReceiveResponse(fd, response)) {
+                    Logger::get()->error("The connection to the server is "
+                            "broken");
+                    failed = true;
+                    break;
+                }
+                latencies[i].push_back(latency.Peek());
+                if (response.find("\"solved\":true") != string::npos) {
+                    solved[i]++;
+                } else if (response.find("\"timed_out\":true") !=
+                        string::npos) {
+                    timed_out[i]++;
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto& it : threads) {
+        it.join();
+    }
+    double wall_time = ts.Peek();
+    if (failed) {
+        return false;
+    }
+
+    vector<double> all_latencies;
+    int solved_count = 0;
+    int timed_out_count = 0;
+    for (int i = 0; i < connections; i++) {
+        all_latencies.insert(all_latencies.end(), latencies[i].begin(),
+                latencies[i].end());
+        solved_count += solved[i];
+        timed_out_count += timed_out[i];
+    }
+    if (all_latencies.empty()) {
+        Logger::get()->info("There are no puzzles to send");
+        return true;
+    }
+    sort(all_latencies.begin(), all_latencies.end());
+    double latency_summary = 0.0;
+    for (double it : all_latencies) {
+        latency_summary += it;
+    }
+
+    int count = all_latencies.size();
+    Logger::get()->info("Sent {} requests from {} connections in {} seconds, "
+            "{} requests/s", count, connections, wall_time,
+            count / wall_time);
+    Logger::get()->info("Responses: {} solved, {} out of time, {} unsolved",
+            solved_count, timed_out_count,
+            count - solved_count - timed_out_count);
+    Logger::get()->info("Latency: average {}, median {}, 99th percentile {}, "
+            "max {} seconds", latency_summary / count,
+            all_latencies[count / 2], all_latencies[count * 99 / 100],
+            all_latencies.back());
+    return true;
+}
+
+void Benchmark::GenerateLine(const LineSet& line_set, unsigned seed,
+        vector<pair<int, int>>& groups, vector<LineMask>& cells) {
+    int length = line_set.length;
+    mt19937 gen(seed);
+    uniform_int_distribution<int> color_dist(0, line_set.color_count - 1);
+    uniform_int_distribution<int> run_dist(1, line_set.max_run);
+    uniform_real_distribution<double> known_dist(0.0, 1.0);
+
+    // Paint the line with random runs of colors
+    vector<int> solution;
+    while (solution.size() < length) {
+        int color = color_dist(gen);
+        int run = run_dist(gen);
+        for (int i = 0; i < run && solution.size() < length; i++) {
+            solution.push_back(color);
+        }
+        // Separate the runs of the same color
+        if (solution.size() < length) {
+            solution.push_back(0);
+        }
+    }
+
+    groups.clear();
+    for (int i = 0; i < length; i++) {
+        if (solution[i] == 0) {
+            continue;
+        }
+        if (i > 0 && solution[i - 1] == solution[i]) {
+            groups.back().first++;
+        } else {
+            groups.push_back({1, solution[i]});
+        }
+    }
+
+    // Reveal some of the cells
+    cells.resize(length);
+    for (int i = 0; i < length; i++) {
+        if (known_dist(gen) < line_set.known_chance) {
+            cells[i] = ColorMask<LineMask>(solution[i]);
+        } else {
+            cells[i] = AllColorsMask<LineMask>(line_set.color_count);
+        }
+    }
+}
+
+bool Benchmark::RunLineSolvers() {
+    Logger::get()->info("Starting a line solvers benchmark...");
+
+    const vector<int> lengths = {10, 50, 100, 250, 500, 1000, 2000};
+    // The lines are solved when all the cells are unknown (at the first
+    // iteration) and when some of the cells are known
+    const vector<double> known_chances = {0.0, 0.3};
+    // Short, long and very long runs of colors, the long groups are marked
+    // many times by the line solvers
+    const vector<int> max_runs = {8, 64, 512};
+    // White-black and colored lines
+    const vector<int> color_counts = {2, 4};
+
+    for (int color_count : color_counts) {
+        vector<LineSolverSetup> engines = {
+            {LineSolverEngine::kRecursive, false, "recursive"},
+            {LineSolverEngine::kIterative, false, "iterative"}
+        };
+        if (color_count == 2) {
+            engines.push_back({LineSolverEngine::kBitset, false, "bitset"});
+        }
+        // The pre-pass works only if all the cells are unknown, otherwise it
+        // shows its overhead
+        engines.push_back({LineSolverEngine::kRecursive, true, "overlap"});
+
+        for (int max_run : max_runs) {
+            for (double known_chance : known_chances) {
+                Logger::get()->info("Colors: {}, max run: {}, known cells: "
+                        "{}%", color_count, max_run, known_chance * 100.0);
+                for (int length : lengths) {
+                    LineSet line_set = {color_count, length, max_run,
+                        known_chance};
+                    if (!RunLineSolvers(engines, line_set)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Benchmark::RunLineSolvers(const vector<LineSolverSetup>& engines,
+        const LineSet& line_set) {
+    // Generate the same lines for every engine
+    vector<vector<pair<int, int>>> groups(kLinesCount);
+    vector<vector<LineMask>> cells(kLinesCount);
+    for (int i = 0; i < kLinesCount; i++) {
+        GenerateLine(line_set, i, groups[i], cells[i]);
+    }
+
+    vector<vector<vector<LineMask>>> results(engines.size(), cells);
+    vector<double> times(engines.size());
+    for (int e = 0; e < engines.size(); e++) {
+        OneLineSolver<LineMask> solver;
+        solver.Init(line_set.length, line_set.color_count, engines[e].engine);
+        solver.SetOverlap(engines[e].overlap);
+
+        // Warm up the memory of the solver
+        for (int i = 0; i < kLinesCount; i++) {
+            vector<LineMask> line = cells[i];
+            solver.UpdateState(groups[i], line);
+        }
+
+        Timespan ts;
+        for (int i = 0; i < kLinesCount; i++) {
+            if (!solver.UpdateState(groups[i], results[e][i])) {
+                Logger::get()->error("Failed to solve a random line");
+                return false;
+            }
+        }
+        times[e] = ts.Peek();
+    }
+
+    stringstream ss;
+    ss << "Length " << line_set.length << ":";
+    for (int e = 0; e < engines.size(); e++) {
+        if (results[e] != results[0]) {
+            Logger::get()->error("The {} engine differs from the {} engine "
+                    "on length {}", engines[e].name, engines[0].name,
+                    line_set.length);
+            return false;
+        }
+        ss << " " << engines[e].name << " " << times[e] << " seconds";
+        if (e > 0) {
+            ss << " (speedup " << times[0] / times[e] << ")";
+        }
+    }
+    Logger::get()->info(ss.str());
     return true;
 }
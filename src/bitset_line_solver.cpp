@@ -0,0 +1,304 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <bitset_line_solver.h>
+
+#include <algorithm>
+#include <utility>
+
+using std::copy;
+using std::fill;
+using std::pair;
+using std::swap;
+using std::vector;
+
+void BitsetLineSolver::Init(int side_length) {
+    Resize(side_length, (side_length + 1) / 2);
+}
+
+void BitsetLineSolver::Resize(int len, int group_count) {
+    // The bits [0..len] are used, because the states may be on the cell
+    // right after the line
+    word_count_ = len / 64 + 1;
+
+    // Only grows, so the memory is allocated once for the longest lines
+    size_t size = word_count_;
+    if (white_.size() < size) {
+        white_.resize(size);
+        black_.resize(size);
+        suffix_.resize(size);
+        next_suffix_.resize(size);
+        result_white_.resize(size);
+        result_black_.resize(size);
+        starts_.resize(size);
+        work_.resize(size);
+        shifted_.resize(size);
+    }
+    if (prefix_.size() < (group_count + 1) * size) {
+        prefix_.resize((group_count + 1) * size);
+    }
+    if (fits_.size() < group_count * size) {
+        fits_.resize(group_count * size);
+    }
+}
+
+void BitsetLineSolver::ShiftUp(const uint64_t* src, int shift, uint64_t* dst) {
+    int words = shift / 64;
+    int bits = shift % 64;
+    // Go from the end, so the source may be the same as the destination
+    for (int i = word_count_ - 1; i >= 0; i--) {
+        uint64_t value = 0;
+        if (i - words >= 0) {
+            value = src[i - words] << bits;
+            if (bits && i - words - 1 >= 0) {
+                value |= src[i - words - 1] >> (64 - bits);
+            }
+        }
+        dst[i] = value;
+    }
+}
+
+void BitsetLineSolver::ShiftDown(const uint64_t* src, int shift,
+        uint64_t* dst) {
+    int words = shift / 64;
+    int bits = shift % 64;
+    // Go from the start, so the source may be the same as the destination
+    for (int i = 0; i < word_count_; i++) {
+        uint64_t value = 0;
+        if (i + words < word_count_) {
+            value = src[i + words] >> bits;
+            if (bits && i + words + 1 < word_count_) {
+                value |= src[i + words + 1] << (64 - bits);
+            }
+        }
+        dst[i] = value;
+    }
+}
+
+void BitsetLineSolver::FillRight(uint64_t* states, const uint64_t* white) {
+    // Adding a state bit to a run of white bits carries it through the run
+    // and sets the bit after the run: the bits from the state to the end of
+    // the run are changed, and the XOR with the white bits shows them.
+    // The states themselves are kept with the OR
+    uint64_t carry = 0;
+    for (int i = 0; i < word_count_; i++) {
+        uint64_t sum = white[i] + (states[i] & white[i]);
+        uint64_t next_carry = sum < white[i];
+        sum += carry;
+        next_carry |= sum < carry;
+        carry = next_carry;
+        states[i] |= sum ^ white[i];
+    }
+}
+
+void BitsetLineSolver::FillLeft(uint64_t* states, const uint64_t* white) {
+    // Carries can't go to the lower bits, so the states are propagated
+    // with doubling steps. After the step with the shift S, the Y-th bit of
+    // the "through" bitset is set if the cells [Y..Y + 2S) are white
+    uint64_t* through = work_.data();
+    copy(white, white + word_count_, through);
+    for (int shift = 1; ; shift *= 2) {
+        ShiftDown(states, shift, shifted_.data());
+        for (int i = 0; i < word_count_; i++) {
+            states[i] |= through[i] & shifted_[i];
+        }
+
+        ShiftDown(through, shift, shifted_.data());
+        uint64_t any = 0;
+        for (int i = 0; i < word_count_; i++) {
+            through[i] &= shifted_[i];
+            any |= through[i];
+        }
+        if (!any) {
+            break;
+        }
+    }
+}
+
+void BitsetLineSolver::FindFits(int length, uint64_t* fits) {
+    // After the step with the shift S, the Y-th bit is set if the cells
+    // [Y..Y + 2S) can be black. The last step is shorter and overlaps
+    copy(black_.begin(), black_.begin() + word_count_, fits);
+    int covered = 1;
+    while (covered * 2 <= length) {
+        ShiftDown(fits, covered, shifted_.data());
+        for (int i = 0; i < word_count_; i++) {
+            fits[i] &= shifted_[i];
+        }
+        covered *= 2;
+    }
+    if (covered < length) {
+        ShiftDown(fits, length - covered, shifted_.data());
+        for (int i = 0; i < word_count_; i++) {
+            fits[i] &= shifted_[i];
+        }
+    }
+}
+
+void BitsetLineSolver::Spread(const uint64_t* starts, int length,
+        uint64_t* cells) {
+    // The same doubling steps as in FindFits(), but to the other side
+    uint64_t* covers = work_.data();
+    copy(starts, starts + word_count_, covers);
+    int covered = 1;
+    while (covered * 2 <= length) {
+        ShiftUp(covers, covered, shifted_.data());
+        for (int i = 0; i < word_count_; i++) {
+            covers[i] |= shifted_[i];
+        }
+        covered *= 2;
+    }
+    if (covered < length) {
+        ShiftUp(covers, length - covered, shifted_.data());
+        for (int i = 0; i < word_count_; i++) {
+            covers[i] |= shifted_[i];
+        }
+    }
+    for (int i = 0; i < word_count_; i++) {
+        cells[i] |= covers[i];
+    }
+}
+
+template <typename Mask>
+bool BitsetLineSolver::UpdateState(const vector<pair<int, int>>& groups,
+        vector<Mask>& cells) {
+    int len = cells.size();
+    Resize(len, groups.size());
+    int words = word_count_;
+
+    // Pack the cells into the bitsets
+    fill(white_.begin(), white_.begin() + words, 0);
+    fill(black_.begin(), black_.begin() + words, 0);
+    for (int i = 0; i < len; i++) {
+        uint64_t bit = 1ull << (i % 64);
+        if (cells[i] & 1) {
+            white_[i / 64] |= bit;
+        }
+        if (cells[i] & 2) {
+            black_[i / 64] |= bit;
+        }
+    }
+
+    if (!UpdateBitsets(groups, len)) {
+        return false;
+    }
+
+    // Unpack the bitsets to the cells
+    for (int i = 0; i < len; i++) {
+        int bit = i % 64;
+        cells[i] = ((result_white_[i / 64] >> bit) & 1) |
+            (((result_black_[i / 64] >> bit) & 1) << 1);
+    }
+    return true;
+}
+
+template bool BitsetLineSolver::UpdateState(
+        const vector<pair<int, int>>& groups, vector<uint8_t>& cells);
+template bool BitsetLineSolver::UpdateState(
+        const vector<pair<int, int>>& groups, vector<uint16_t>& cells);
+template bool BitsetLineSolver::UpdateState(
+        const vector<pair<int, int>>& groups, vector<uint32_t>& cells);
+template bool BitsetLineSolver::UpdateState(
+        const vector<pair<int, int>>& groups, vector<uint64_t>& cells);
+
+bool BitsetLineSolver::UpdateBitsets(const vector<pair<int, int>>& groups,
+        int len) {
+    int group_count = groups.size();
+    int words = word_count_;
+    const uint64_t* white = white_.data();
+    uint64_t* starts = starts_.data();
+
+    // Prefix: the states reachable from the start of the line. A group
+    // placed on the Y-th cell moves the state to the (Y + length)-th cell,
+    // and also requires a white cell after it if it isn't the last group
+    uint64_t* prefix = prefix_.data();
+    fill(prefix, prefix + words, 0);
+    prefix[0] = 1;
+    FillRight(prefix, white);
+    for (int group = 0; group < group_count; group++) {
+        int length = groups[group].first;
+        bool last = group + 1 == group_count;
+        const uint64_t* states = prefix + group * words;
+        uint64_t* next_states = prefix + (group + 1) * words;
+        uint64_t* fits = fits_.data() + group * words;
+
+        FindFits(length, fits);
+        for (int i = 0; i < words; i++) {
+            next_states[i] = states[i] & fits[i];
+        }
+        ShiftUp(next_states, length, next_states);
+        if (!last) {
+            for (int i = 0; i < words; i++) {
+                next_states[i] &= white[i];
+            }
+            ShiftUp(next_states, 1, next_states);
+        }
+        FillRight(next_states, white);
+    }
+
+    // All the groups should have been placed at the end of the line
+    const uint64_t* last_states = prefix + group_count * words;
+    if (!((last_states[len / 64] >> (len % 64)) & 1)) {
+        return false;
+    }
+
+    // Suffix: the states from which the end of the line can be reached.
+    // A placement is a part of a correct filling if it starts from a state
+    // of the prefix and ends in a state of the suffix, so the cells are marked
+    // in the same pass
+    uint64_t* suffix = suffix_.data();
+    uint64_t* next_suffix = next_suffix_.data();
+    fill(suffix, suffix + words, 0);
+    suffix[len / 64] = 1ull << (len % 64);
+    FillLeft(suffix, white);
+
+    fill(result_white_.begin(), result_white_.begin() + words, 0);
+    fill(result_black_.begin(), result_black_.begin() + words, 0);
+    for (int group = group_count; group >= 0; group--) {
+        const uint64_t* states = prefix + group * words;
+
+        // WHITE cells between the groups
+        ShiftDown(suffix, 1, shifted_.data());
+        for (int i = 0; i < words; i++) {
+            result_white_[i] |= states[i] & white[i] & shifted_[i];
+        }
+
+        if (group == 0) {
+            break;
+        }
+
+        // The starts of the previous group leading to the suffix
+        int prev = group - 1;
+        int length = groups[prev].first;
+        bool last = group == group_count;
+        const uint64_t* fits = fits_.data() + prev * words;
+        const uint64_t* prev_states = prefix + prev * words;
+        if (last) {
+            ShiftDown(suffix, length, next_suffix);
+        } else {
+            ShiftDown(suffix, length + 1, next_suffix);
+            ShiftDown(white, length, shifted_.data());
+            for (int i = 0; i < words; i++) {
+                next_suffix[i] &= shifted_[i];
+            }
+        }
+        for (int i = 0; i < words; i++) {
+            next_suffix[i] &= fits[i];
+            starts[i] = next_suffix[i] & prev_states[i];
+        }
+
+        // BLACK cells of the group and the WHITE cell after it
+        Spread(starts, length, result_black_.data());
+        if (!last) {
+            ShiftUp(starts, length, starts);
+            for (int i = 0; i < words; i++) {
+                result_white_[i] |= starts[i];
+            }
+        }
+
+        FillLeft(next_suffix, white);
+        swap(suffix, next_suffix);
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <frame_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using std::get;
+using std::lround;
+using std::max;
+using std::min;
+
+FrameBuffer::FrameBuffer(int width, int height, const Color& background)
+        : width_(width), height_(height),
+          pixels_(static_cast<size_t>(width) * height * 3) {
+    if (width_ > 0 && height_ > 0) {
+        FrameBand(*this).Fill(background, 0, 0, width_, height_);
+    }
+}
+
+FrameBand::FrameBand(FrameBuffer& buffer)
+        : FrameBand(buffer, 0, buffer.height()) {}
+
+FrameBand::FrameBand(FrameBuffer& buffer, int top, int bottom)
+        : buffer_(buffer), top_(max(top, 0)),
+          bottom_(min(bottom, buffer.height())) {}
+
+bool FrameBand::Clip(int& x, int& y, int& width, int& height) const {
+    int left = max(x, 0);
+    int right = min(x + width, buffer_.width());
+    int top = max(y, top_);
+    int bottom = min(y + height, bottom_);
+    if (left >= right || top >= bottom) {
+        return false;
+    }
+    x = left;
+    y = top;
+    width = right - left;
+    height = bottom - top;
+    return true;
+}
+
+void FrameBand::Fill(const Color& color, int x, int y, int width,
+        int height) {
+    if (!Clip(x, y, width, height)) {
+        return;
+    }
+    uint8_t* first = buffer_.row(y) + x * 3;
+    for (int i = 0; i < width; i++) {
+        first[i * 3] = get<0>(color);
+        first[i * 3 + 1] = get<1>(color);
+        first[i * 3 + 2] = get<2>(color);
+    }
+    for (int row = y + 1; row < y + height; row++) {
+        memcpy(buffer_.row(row) + x * 3, first, width * 3);
+    }
+}
+
+void FrameBand::CopyRow(int from_y, int to_y) {
+    if (to_y < top_ || to_y >= bottom_ || from_y == to_y) {
+        return;
+    }
+    memcpy(buffer_.row(to_y), buffer_.row(from_y), buffer_.width() * 3);
+}
+
+void FrameBand::Darken(double multiplier, int x, int y, int width,
+        int height) {
+    if (!Clip(x, y, width, height)) {
+        return;
+    }
+    // Every channel is mapped by the table, so the rows are done by bytes
+    uint8_t table[256];
+    for (int v = 0; v < 256; v++) {
+        table[v] = static_cast<uint8_t>(min(255L, lround(v * multiplier)));
+    }
+    for (int row = y; row < y + height; row++) {
+        uint8_t* pixels = buffer_.row(row) + x * 3;
+        for (int i = 0; i < width * 3; i++) {
+            pixels[i] = table[pixels[i]];
+        }
+    }
+}
@@ -0,0 +1,302 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <image_writer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <logger.h>
+
+using std::min;
+using std::ofstream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+bool ParseImageFormat(const string& name, ImageFormat& format) {
+    if (name == "png") {
+        format = ImageFormat::kPng;
+    } else if (name == "ppm") {
+        format = ImageFormat::kPpm;
+    } else if (name == "magick") {
+        format = ImageFormat::kMagick;
+    } else {
+        Logger::get()->error("Unknown image format - {}", name);
+        return false;
+    }
+    return true;
+}
+
+const char* ImageExtension(ImageFormat format) {
+    return format == ImageFormat::kPpm ? ".ppm" : ".png";
+}
+
+/* Helper functions */
+
+// The lengths and the distances of the deflate matches, the first one of a
+// code and the count of its extra bits
+static const int kLengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17,
+        19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227,
+        258};
+static const int kLengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2,
+        2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int kDistanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49,
+        65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+        6145, 8193, 12289, 16385, 24577};
+static const int kDistanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5,
+        5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static const int kMinMatch = 3;
+static const int kMaxMatch = 258;
+static const int kMaxDistance = 32768;
+
+// Writes the bits of a deflate stream, they fill the bytes from the lowest
+// bit
+class BitWriter {
+ public:
+    explicit BitWriter(vector<uint8_t>& out) : out_(out) {}
+
+    void Write(uint32_t bits, int count) {
+        bits_ |= static_cast<uint64_t>(bits) << count_;
+        count_ += count;
+        while (count_ >= 8) {
+            out_.push_back(bits_ & 0xff);
+            bits_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    // The Huffman codes are written from the highest bit
+    void WriteCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        Write(reversed, length);
+    }
+
+    void Flush() {
+        if (count_ > 0) {
+            out_.push_back(bits_ & 0xff);
+        }
+        bits_ = 0;
+        count_ = 0;
+    }
+
+ private:
+    vector<uint8_t>& out_;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+// Writes a literal, a length code or the end of the block by the fixed
+// Huffman codes
+static void WriteSymbol(BitWriter& writer, int symbol) {
+    if (symbol < 144) {
+        writer.WriteCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.WriteCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.WriteCode(symbol - 256, 7);
+    } else {
+        writer.WriteCode(0xc0 + symbol - 280, 8);
+    }
+}
+
+static void WriteMatch(BitWriter& writer, int length, int distance) {
+    int code = 0;
+    while (code + 1 < sizeof(kLengthBase) / sizeof(int) &&
+            kLengthBase[code + 1] <= length) {
+        code++;
+    }
+    WriteSymbol(writer, 257 + code);
+    writer.Write(length - kLengthBase[code], kLengthExtra[code]);
+
+    code = 0;
+    while (code + 1 < sizeof(kDistanceBase) / sizeof(int) &&
+            kDistanceBase[code + 1] <= distance) {
+        code++;
+    }
+    writer.WriteCode(code, 5);
+    writer.Write(distance - kDistanceBase[code], kDistanceExtra[code]);
+}
+
+// Compresses the data to one block with the fixed codes, the matches are
+// looked for only at the given distances
+static void Deflate(const vector<uint8_t>& data,
+        const vector<int>& distances, vector<uint8_t>& out) {
+    BitWriter writer(out);
+    writer.Write(1, 1);  // The last block
+    writer.Write(1, 2);  // The fixed codes
+    size_t pos = 0;
+    while (pos < data.size()) {
+        int best_length = 0;
+        int best_distance = 0;
+        int limit = min<size_t>(kMaxMatch, data.size() - pos);
+        for (int distance : distances) {
+            if (distance > pos || distance > kMaxDistance) {
+                continue;
+            }
+            const uint8_t* cur = data.data() + pos;
+            const uint8_t* prev = cur - distance;
+            int length = 0;
+            while (length < limit && cur[length] == prev[length]) {
+                length++;
+            }
+            if (length > best_length) {
+                best_length = length;
+                best_distance = distance;
+            }
+        }
+        if (best_length >= kMinMatch) {
+            WriteMatch(writer, best_length, best_distance);
+            pos += best_length;
+        } else {
+            WriteSymbol(writer, data[pos]);
+            pos++;
+        }
+    }
+    WriteSymbol(writer, 256);  // The end of the block
+    writer.Flush();
+}
+
+// Stores the data in the blocks without compression, used if the deflate
+// doesn't make it smaller
+static void Store(const vector<uint8_t>& data, vector<uint8_t>& out) {
+    const size_t kMaxBlock = 65535;
+    size_t pos = 0;
+    do {
+        size_t size = min(kMaxBlock, data.size() - pos);
+        bool last = pos + size == data.size();
+        out.push_back(last ? 1 : 0);  // The stored block, aligned to a byte
+        out.push_back(size & 0xff);
+        out.push_back(size >> 8);
+        out.push_back(~size & 0xff);
+        out.push_back((~size >> 8) & 0xff);
+        out.insert(out.end(), data.begin() + pos, data.begin() + pos + size);
+        pos += size;
+    } while (pos < data.size());
+}
+
+static uint32_t Adler32(const vector<uint8_t>& data) {
+    // The sums don't overflow for 5552 bytes, so the modulo is taken once
+    // for them
+    const uint32_t kMod = 65521;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t pos = 0; pos < data.size(); pos += 5552) {
+        size_t end = min<size_t>(pos + 5552, data.size());
+        for (size_t i = pos; i < end; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= kMod;
+        b %= kMod;
+    }
+    return (b << 16) | a;
+}
+
+static vector<uint32_t> MakeCrcTable() {
+    vector<uint32_t> table(256);
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size) {
+    static const vector<uint32_t> table = MakeCrcTable();
+    uint32_t c = 0xffffffffu;
+    for (size_t i = 0; i < size; i++) {
+        c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+static void PushBigEndian(vector<uint8_t>& out, uint32_t value) {
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xff);
+    out.push_back((value >> 8) & 0xff);
+    out.push_back(value & 0xff);
+}
+
+// Appends the chunk of the png file, the crc covers the type and the data
+static void PushChunk(vector<uint8_t>& out, const char* type,
+        const vector<uint8_t>& data) {
+    PushBigEndian(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PushBigEndian(out, Crc32(out.data() + start, out.size() - start));
+}
+
+static bool WriteFile(const string& filename, const char* header,
+        size_t header_size, const uint8_t* data, size_t size) {
+    ofstream fout(filename, std::ios::binary);
+    fout.write(header, header_size);
+    fout.write(reinterpret_cast<const char*>(data), size);
+    if (!fout) {
+        Logger::get()->error("Can't write the image to {}", filename);
+        return false;
+    }
+    return true;
+}
+
+/* Public functions */
+
+bool ImageWriter::WritePng(const FrameBuffer& buffer,
+        const string& filename) {
+    // Every row starts with the filter byte, no filter is used
+    int stride = buffer.width() * 3 + 1;
+    vector<uint8_t> rows(static_cast<size_t>(stride) * buffer.height());
+    for (int y = 0; y < buffer.height(); y++) {
+        uint8_t* row = rows.data() + static_cast<size_t>(y) * stride;
+        row[0] = 0;
+        std::copy(buffer.row(y), buffer.row(y) + stride - 1, row + 1);
+    }
+
+    // The zlib stream with the smallest window and no dictionary. The cells
+    // of the cool images have the separators every few pixels and rows, so
+    // the matches are also looked for two pixels and two rows back
+    vector<uint8_t> idat = {0x78, 0x01};
+    Deflate(rows, {3, 6, stride, stride * 2}, idat);
+    if (idat.size() > rows.size() + rows.size() / 65535 * 5 + 7) {
+        idat.resize(2);
+        Store(rows, idat);
+    }
+    PushBigEndian(idat, Adler32(rows));
+
+    vector<uint8_t> ihdr;
+    PushBigEndian(ihdr, buffer.width());
+    PushBigEndian(ihdr, buffer.height());
+    ihdr.push_back(8);  // The bits of a channel
+    ihdr.push_back(2);  // RGB
+    ihdr.push_back(0);  // The compression, the filter and no interlace
+    ihdr.push_back(0);
+    ihdr.push_back(0);
+
+    const char kSignature[] = "\x89PNG\r\n\x1a\n";
+    vector<uint8_t> png;
+    PushChunk(png, "IHDR", ihdr);
+    PushChunk(png, "IDAT", idat);
+    PushChunk(png, "IEND", {});
+    return WriteFile(filename, kSignature, sizeof(kSignature) - 1,
+            png.data(), png.size());
+}
+
+bool ImageWriter::WritePpm(const FrameBuffer& buffer,
+        const string& filename) {
+    string header = "P6\n" + to_string(buffer.width()) + " " +
+        to_string(buffer.height()) + "\n255\n";
+    return WriteFile(filename, header.data(), header.size(), buffer.data(),
+            static_cast<size_t>(buffer.width()) * buffer.height() * 3);
+}
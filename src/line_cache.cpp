@@ -0,0 +1,114 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <line_cache.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <logger.h>
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+LineCache* LineCache::get() {
+    static LineCache cache;
+    return &cache;
+}
+
+void LineCache::Init(size_t max_memory) {
+    lock_guard<mutex> lock(mutex_);
+    index_.clear();
+    entries_.clear();
+    free_entries_.clear();
+    clock_hand_ = 0;
+    memory_ = 0;
+    max_memory_ = max_memory;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+bool LineCache::Find(const string& key, string& cells) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    Entry& entry = entries_[it->second];
+    entry.referenced = true;
+    cells = entry.cells;
+    return true;
+}
+
+void LineCache::Insert(const string& key, const string& cells) {
+    size_t memory = key.size() + cells.size() + kEntryOverhead;
+    lock_guard<mutex> lock(mutex_);
+    if (memory > max_memory_ || index_.count(key)) {
+        return;
+    }
+    while (memory_ + memory > max_memory_) {
+        Evict();
+    }
+
+    int index;
+    if (!free_entries_.empty()) {
+        index = free_entries_.back();
+        free_entries_.pop_back();
+    } else {
+        index = entries_.size();
+        entries_.emplace_back();
+    }
+    auto it = index_.emplace(key, index).first;
+    Entry& entry = entries_[index];
+    entry.key = &it->first;
+    entry.cells = cells;
+    entry.referenced = false;
+    memory_ += memory;
+}
+
+void LineCache::Evict() {
+    // There is at least one entry, because the memory isn't empty
+    while (true) {
+        if (clock_hand_ >= entries_.size()) {
+            clock_hand_ = 0;
+        }
+        int index = clock_hand_++;
+        Entry& entry = entries_[index];
+        if (!entry.key) {
+            continue;
+        }
+        if (entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+
+        memory_ -= EntryMemory(entry);
+        index_.erase(*entry.key);
+        entry.key = nullptr;
+        string().swap(entry.cells);
+        free_entries_.push_back(index);
+        return;
+    }
+}
+
+size_t LineCache::EntryMemory(const Entry& entry) const {
+    return entry.key->size() + entry.cells.size() + kEntryOverhead;
+}
+
+void LineCache::LogStats() const {
+    if (!Enabled()) {
+        return;
+    }
+    lock_guard<mutex> lock(mutex_);
+    int64_t lookups = hits_ + misses_;
+    double hit_rate = lookups ? static_cast<double>(hits_) /
+        static_cast<double>(lookups) * 100.0 : 0.0;
+    Logger::get()->info("Line cache: {} hits, {} misses ({:.1f}% hit rate), "
+            "{} entries, {} of {} bytes used", hits_, misses_, hit_rate,
+            index_.size(), memory_, max_memory_);
+}
@@ -0,0 +1,181 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <line_scheduler.h>
+
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <logger.h>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+bool LineScheduler::ParseHeuristic(const string& name, Heuristic& heuristic) {
+    for (const auto& it : Heuristics()) {
+        if (it.second == name) {
+            heuristic = it.first;
+            return true;
+        }
+    }
+    Logger::get()->error("Unknown line scheduler heuristic - {}", name);
+    return false;
+}
+
+const vector<pair<LineScheduler::Heuristic, string>>&
+        LineScheduler::Heuristics() {
+    // Built once, the names are looked up for every puzzle
+    static const vector<pair<Heuristic, string>> heuristics = {
+        {Heuristic::kSweep, "sweep"},
+        {Heuristic::kFixed, "fixed"},
+        {Heuristic::kSlack, "slack"},
+        {Heuristic::kUnknown, "unknown"}
+    };
+    return heuristics;
+}
+
+void LineScheduler::Init(Heuristic heuristic,
+        const vector<vector<pair<int, int>>>& row_groups,
+        const vector<vector<pair<int, int>>>& col_groups, bool queue_all) {
+    heuristic_ = heuristic;
+    row_count_ = row_groups.size();
+    line_count_ = row_count_ + col_groups.size();
+
+    queued_.assign(line_count_, 0);
+    dead_.assign(line_count_, 0);
+    fixed_.assign(line_count_, 0);
+    slack_.resize(line_count_);
+    unknown_.resize(line_count_);
+    for (int line = 0; line < line_count_; line++) {
+        bool is_row = line < row_count_;
+        const auto& groups = is_row ? row_groups[line] :
+            col_groups[line - row_count_];
+        int length = is_row ? col_groups.size() : row_groups.size();
+
+        // The groups of the same color are separated by a white cell
+        int min_length = 0;
+        for (int i = 0; i < groups.size(); i++) {
+            min_length += groups[i].first;
+            if (i > 0 && groups[i - 1].second == groups[i].second) {
+                min_length++;
+            }
+        }
+        slack_[line] = length - min_length;
+        unknown_[line] = length;
+    }
+
+    rows_.clear();
+    cols_.clear();
+    solving_.clear();
+    solving_pos_ = 0;
+    solving_rows_ = false;
+    // Keeps the memory of the queue, it's usually empty here
+    while (!queue_.empty()) {
+        queue_.pop();
+    }
+    priority_.assign(line_count_, 0);
+    popped_ = 0;
+
+    for (int line = 0; queue_all && line < line_count_; line++) {
+        Enqueue(line);
+    }
+}
+
+int64_t LineScheduler::Priority(int line) const {
+    switch (heuristic_) {
+        case Heuristic::kFixed:
+            return fixed_[line];
+        case Heuristic::kSlack:
+            return -slack_[line];
+        case Heuristic::kUnknown:
+            return -unknown_[line];
+        default:
+            return 0;
+    }
+}
+
+void LineScheduler::Enqueue(int line) {
+    if (heuristic_ == Heuristic::kSweep) {
+        if (!queued_[line]) {
+            (line < row_count_ ? rows_ : cols_).push_back(line);
+        }
+    } else {
+        // Add an element if the line isn't queued or its priority has changed
+        int64_t priority = Priority(line);
+        if (!queued_[line] || priority != priority_[line]) {
+            priority_[line] = priority;
+            queue_.push({priority, -line});
+        }
+    }
+    queued_[line] = 1;
+}
+
+bool LineScheduler::Pop(int& line, bool& new_step) {
+    new_step = false;
+    if (heuristic_ == Heuristic::kSweep) {
+        // Take the queued columns after the rows, and the queued rows after
+        // the columns
+        while (solving_pos_ == solving_.size()) {
+            if (rows_.empty() && cols_.empty()) {
+                return false;
+            }
+            solving_rows_ = !solving_rows_;
+            solving_.swap(solving_rows_ ? rows_ : cols_);
+            (solving_rows_ ? rows_ : cols_).clear();
+            solving_pos_ = 0;
+            new_step |= solving_rows_;
+        }
+        line = solving_[solving_pos_++];
+    } else {
+        while (true) {
+            if (queue_.empty()) {
+                return false;
+            }
+            line = -queue_.top().second;
+            int64_t priority = queue_.top().first;
+            queue_.pop();
+            if (queued_[line] && priority == priority_[line]) {
+                break;
+            }
+        }
+        new_step = popped_ % line_count_ == 0;
+        popped_++;
+    }
+    queued_[line] = 0;
+    return true;
+}
+
+bool LineScheduler::PopBatch(vector<int>& lines, bool& new_step) {
+    int line;
+    if (!Pop(line, new_step)) {
+        return false;
+    }
+    lines.assign(1, line);
+    while (solving_pos_ < solving_.size()) {
+        line = solving_[solving_pos_++];
+        queued_[line] = 0;
+        lines.push_back(line);
+    }
+    return true;
+}
+
+void LineScheduler::Push(int line, bool known) {
+    if (dead_[line]) {
+        return;
+    }
+    if (known) {
+        fixed_[line]++;
+        unknown_[line]--;
+    }
+    Enqueue(line);
+}
+
+void LineScheduler::Solved(int line, int unknown_cells) {
+    fixed_[line] = 0;
+    unknown_[line] = unknown_cells;
+    dead_[line] = unknown_cells == 0;
+}
@@ -3,16 +3,24 @@
  * This code is released under the license described in the LICENSE file
  */
 #include <iostream>
+#include <vector>
 
 #include <arguments.h>
 #include <benchmark.h>
+#include <line_cache.h>
 #include <logger.h>
 #include <paint.h>
 #include <puzzle.h>
+#include <puzzle_pack.h>
+#include <solve_options.h>
+#include <solve_server.h>
+#include <stream_solver.h>
 #include <timespan.h>
-#include <Magick++.h>
 
 
+// The line cache size (in MB) used by --count-solutions by default
+const size_t kCountSolutionsLineCache = 64;
+
 int InitArguments(int argc, char** argv) {
     try {
         cli_args::parser.ParseCLI(argc, argv);
@@ -35,18 +43,107 @@ int InitArguments(int argc, char** argv) {
     return -1;  // Success, run further
 }
 
+// Writes the puzzle to the file with the .pzb extension, the puzzles encoded
+// from the images are colored
+bool Compile(const std::string& path, bool colored,
+        const SolveOptions& options) {
+    std::string compiled_path = path.substr(0, path.find_last_of('.')) +
+        Puzzle::kCompiledExtension;
+    Logger::get()->info("Compile the puzzle to {}", compiled_path);
+    Puzzle puzzle(options);
+    bool read = colored ? puzzle.ReadColored(path) : puzzle.Read(path);
+    return read && puzzle.WriteCompiled(compiled_path);
+}
+
+// Solves the puzzle of the pack given by --puzzle, or all its puzzles one by
+// one with the same context
+bool SolvePack(const std::string& path, const SolveOptions& options) {
+    PuzzlePack pack;
+    if (!pack.Open(path, !cli_args::no_mmap)) {
+        return false;
+    }
+    int first = 0;
+    int last = pack.size();
+    if (cli_args::pack_puzzle) {
+        std::string name = args::get(cli_args::pack_puzzle);
+        first = pack.Find(name);
+        if (first < 0) {
+            Logger::get()->error("There is no puzzle {} in the pack {}", name,
+                    path);
+            return false;
+        }
+        last = first + 1;
+    }
+
+    Puzzle::SolverContext context;
+    std::vector<char> buffer;
+    for (int i = first; i < last; i++) {
+        const char* data;
+        size_t size;
+        Puzzle puzzle(options, &context);
+        if (!pack.Load(i, buffer, data, size) ||
+                !puzzle.Solve(pack.name(i), data, size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int Init(int argc, char** argv) {
     Logger::Init();
-    Magick::InitializeMagick(*argv);
-    return InitArguments(argc, argv);
+    int init = InitArguments(argc, argv);
+    if (init >= 0) {
+        return init;
+    }
+
+    // The stream takes stdout for the results. ImageMagick is initialized
+    // by Paint when it's needed
+    if (cli_args::stream || cli_args::async_log) {
+        Logger::Create(cli_args::stream, cli_args::async_log);
+    }
+    return init;
 }
 
 int Run() {
+    // Counting the solutions meets the same lines in many branches, so it
+    // uses the cache unless its size is given
+    size_t line_cache = args::get(cli_args::line_cache);
+    if (!cli_args::line_cache && cli_args::count_solutions) {
+        line_cache = kCountSolutionsLineCache;
+    }
+    if (line_cache) {
+        LineCache::get()->Init(line_cache << 20);
+    }
+    SolveOptions options;
+    if (!cli_args::GetSolveOptions(options)) {
+        return 1;
+    }
+
     // Either do nothing, or convert an image to a puzzle,
-    // or launch benchmark on a folder, or solve a puzzle
+    // or launch benchmark on a folder, or solve a puzzle or a stream of them
     if (!cli_args::inputPuzzle && !cli_args::benchmark &&
-            !cli_args::inputImage) {
+            !cli_args::inputImage && !cli_args::line_benchmark &&
+            !cli_args::stream && !cli_args::serve) {
         Logger::get()->info("There is nothing to solve");
+    } else if (cli_args::serve) {
+        SolveServer server(args::get(cli_args::jobs),
+                args::get(cli_args::max_in_flight),
+                args::get(cli_args::timeout));
+        if (!server.Run(args::get(cli_args::serve), options)) {
+            return 1;
+        }
+    } else if (cli_args::stream) {
+        // The stream draws the images only if their name is given
+        options.draw.enabled = cli_args::imageName;
+        StreamSolver solver(options);
+        if (!solver.Run(std::cin, std::cout, args::get(cli_args::timeout))) {
+            return 1;
+        }
+    } else if (cli_args::line_benchmark) {
+        Benchmark benchmark(options);
+        if (!benchmark.RunLineSolvers()) {
+            return 1;
+        }
     } else if (cli_args::inputImage) {
         std::string image_path = args::get(cli_args::inputImage);
         std::string result_path = image_path.substr(0,
@@ -54,18 +151,29 @@ int Run() {
         Logger::get()->info("Trying to encode {}", image_path);
         Logger::get()->info("Save the puzzle to {}", result_path);
         Paint::EncodeImage(image_path, result_path);
+        if (cli_args::compile && !Compile(result_path, true, options)) {
+            return 1;
+        }
     } else if (cli_args::benchmark) {
-        Benchmark benchmark;
+        Benchmark benchmark(options);
         if (!benchmark.Run(args::get(cli_args::benchmark))) {
             return 1;
         }
+    } else if (cli_args::compile) {
+        if (!Compile(args::get(cli_args::inputPuzzle), false, options)) {
+            return 1;
+        }
     } else {
         Timespan ts;
-        Puzzle puzzle;
-        if (!puzzle.Solve(args::get(cli_args::inputPuzzle))) {
+        std::string path = args::get(cli_args::inputPuzzle);
+        Puzzle puzzle(options);
+        bool solved = PuzzlePack::IsPack(path) ? SolvePack(path, options) :
+            puzzle.Solve(path);
+        if (!solved) {
             return 1;
         }
         ts.Peek(true);
+        LineCache::get()->LogStats();
     }
 
     return 0;
@@ -77,5 +185,7 @@ int main(int argc, char** argv) {
         return init;
     }
 
-    return Run();
+    int result = Run();
+    Logger::Shutdown();
+    return result;
 }
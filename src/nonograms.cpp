@@ -0,0 +1,181 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <nonograms.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include <logger.h>
+#include <puzzle.h>
+#include <solve_options.h>
+
+using std::call_once;
+using std::exception;
+using std::get;
+using std::once_flag;
+using std::vector;
+
+// The logger is created once by the first call
+static once_flag logger_once;
+
+// Converts the options of the C interface, returns false if an engine or a
+// heuristic is unknown
+static bool GetSolveOptions(const nono_options& opts, int format,
+        SolveOptions& options) {
+    options.black = format == NONO_FORMAT_BLACK;
+    switch (opts.line_solver) {
+        case NONO_LINE_SOLVER_DEFAULT:
+            break;
+        case NONO_LINE_SOLVER_ITERATIVE:
+            options.line_solver = LineSolverEngine::kIterative;
+            break;
+        case NONO_LINE_SOLVER_RECURSIVE:
+            options.line_solver = LineSolverEngine::kRecursive;
+            break;
+        case NONO_LINE_SOLVER_BITSET:
+            options.line_solver = LineSolverEngine::kBitset;
+            break;
+        default:
+            Logger::get()->error("Unknown line solver engine - {}",
+                    opts.line_solver);
+            return false;
+    }
+    options.line_solver_set = opts.line_solver != NONO_LINE_SOLVER_DEFAULT;
+
+    // The heuristics are listed in the order of the enum
+    const auto& heuristics = LineScheduler::Heuristics();
+    if (opts.heuristic < 0 || opts.heuristic >= heuristics.size()) {
+        Logger::get()->error("Unknown line scheduler heuristic - {}",
+                opts.heuristic);
+        return false;
+    }
+    options.heuristic = heuristics[opts.heuristic].first;
+
+    options.overlap = opts.overlap != 0;
+    options.search = opts.search != 0;
+    options.count_solutions = opts.count_solutions;
+    options.threads = opts.threads;
+    return true;
+}
+
+// Copies the cells and the colors of the read puzzle to the result, returns
+// false if the memory can't be allocated
+static bool FillResult(const Puzzle& puzzle, nono_result& result) {
+    vector<int> cells;
+    puzzle.GetCells(result.rows, result.columns, cells);
+    const vector<Puzzle::Color>& colors = puzzle.colors();
+    result.cells = static_cast<int*>(malloc(
+                (cells.size() ? cells.size() : 1) * sizeof(int)));
+    result.colors = static_cast<uint8_t*>(malloc(colors.size() * 3 + 1));
+    if (!result.cells || !result.colors) {
+        return false;
+    }
+    memcpy(result.cells, cells.data(), cells.size() * sizeof(int));
+    result.color_count = colors.size();
+    for (int i = 0; i < colors.size(); i++) {
+        result.colors[i * 3] = get<0>(colors[i]);
+        result.colors[i * 3 + 1] = get<1>(colors[i]);
+        result.colors[i * 3 + 2] = get<2>(colors[i]);
+    }
+    result.solution_count = puzzle.solution_count();
+    result.line_solves = puzzle.line_solves();
+    return true;
+}
+
+// Reads and solves the puzzle, returns the status of the result
+static int Solve(const nono_config& config, const SolveOptions& options,
+        int timeout, nono_result& result) {
+    Puzzle puzzle(options);
+    puzzle.SetName(config.name ? config.name : "puzzle");
+    if (timeout > 0) {
+        puzzle.SetDeadline(std::chrono::steady_clock::now() +
+                std::chrono::milliseconds(timeout));
+    }
+
+    bool read;
+    if (config.format == NONO_FORMAT_COMPILED) {
+        // The compiled puzzle is read by words
+        vector<uint32_t> aligned;
+        const char* data = config.data;
+        if (reinterpret_cast<uintptr_t>(data) % sizeof(uint32_t) != 0) {
+            aligned.resize(config.size / sizeof(uint32_t) + 1);
+            memcpy(aligned.data(), data, config.size);
+            data = reinterpret_cast<const char*>(aligned.data());
+        }
+        read = puzzle.ReadCompiled(data, config.size);
+    } else if (config.format == NONO_FORMAT_BLACK) {
+        read = puzzle.ReadBlack(config.data, config.size);
+    } else {
+        read = puzzle.ReadColored(config.data, config.size);
+    }
+    if (!read) {
+        Logger::get()->error("Can't read the puzzle {}",
+                config.name ? config.name : "");
+        return NONO_INVALID_PUZZLE;
+    }
+
+    bool solved = puzzle.Solve() && puzzle.solution_count() != 0;
+    if (!FillResult(puzzle, result)) {
+        return NONO_ERROR;
+    }
+    if (solved) {
+        return NONO_SOLVED;
+    }
+    return puzzle.timed_out() ? NONO_TIMED_OUT : NONO_UNSOLVED;
+}
+
+void nono_options_init(nono_options* opts) {
+    opts->line_solver = NONO_LINE_SOLVER_DEFAULT;
+    opts->heuristic = NONO_HEURISTIC_SWEEP;
+    opts->overlap = 1;
+    opts->search = 0;
+    opts->count_solutions = 0;
+    opts->threads = 1;
+    opts->timeout = 0;
+}
+
+int nono_solve(const nono_config* config, const nono_options* opts,
+        nono_result* out) {
+    call_once(logger_once, Logger::InitLibrary);
+    memset(out, 0, sizeof(*out));
+    out->solution_count = -1;
+
+    nono_options default_opts;
+    if (!opts) {
+        nono_options_init(&default_opts);
+        opts = &default_opts;
+    }
+    SolveOptions options;
+    if (config->format < NONO_FORMAT_COLORED ||
+            config->format > NONO_FORMAT_COMPILED) {
+        Logger::get()->error("Unknown puzzle format - {}", config->format);
+        out->status = NONO_ERROR;
+    } else if (!GetSolveOptions(*opts, config->format, options)) {
+        out->status = NONO_ERROR;
+    } else {
+        // The exceptions don't pass the C interface
+        try {
+            out->status = Solve(*config, options, opts->timeout, *out);
+        } catch (const exception& e) {
+            Logger::get()->error("Can't solve the puzzle: {}", e.what());
+            out->status = NONO_ERROR;
+        }
+    }
+    if (out->status == NONO_INVALID_PUZZLE || out->status == NONO_ERROR) {
+        nono_result_free(out);
+    }
+    return out->status;
+}
+
+void nono_result_free(nono_result* result) {
+    free(result->cells);
+    free(result->colors);
+    result->cells = nullptr;
+    result->colors = nullptr;
+}
@@ -5,25 +5,58 @@
 #include <one_line_solver.h>
 
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <sstream>
 #include <utility>
 
 #include <logger.h>
 
+using std::fill;
+using std::numeric_limits;
 using std::pair;
+using std::string;
 using std::stringstream;
 using std::vector;
 
-bool OneLineSolver::Init(int side_length, int color_count) {
+bool ParseLineSolverEngine(const string& name, LineSolverEngine& engine) {
+    if (name == "iterative") {
+        engine = LineSolverEngine::kIterative;
+    } else if (name == "recursive") {
+        engine = LineSolverEngine::kRecursive;
+    } else if (name == "bitset") {
+        engine = LineSolverEngine::kBitset;
+    } else {
+        Logger::get()->error("Unknown line solver engine - {}", name);
+        return false;
+    }
+    return true;
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::Init(int side_length, int color_count,
+        Engine engine) {
     if (!CheckMaxColorsOverflow(color_count)) {
         return false;
     }
     CheckMaxPreferredColorsOverflow(color_count);
-    AllocMemory(side_length);
+    if (engine == Engine::kBitset && color_count != 2) {
+        Logger::get()->error("The bitset engine can't work with {} colors",
+                color_count);
+        return false;
+    }
+    engine_ = engine;
+    line_cache_ = nullptr;
+    overlap_ = true;
+    quiet_ = false;
+    overlap_solves_ = 0;
+    full_solves_ = 0;
+    AllocMemory(side_length, color_count);
     return true;
 }
 
-bool OneLineSolver::CheckMaxColorsOverflow(int color_count) {
+template <typename Mask>
+bool OneLineSolver<Mask>::CheckMaxColorsOverflow(int color_count) {
     if (color_count > kMaxColorsCount) {
         Logger::get()->error("Can't work with so many colors - {}",
                 color_count);
@@ -34,7 +67,8 @@ bool OneLineSolver::CheckMaxColorsOverflow(int color_count) {
     return true;
 }
 
-void OneLineSolver::CheckMaxPreferredColorsOverflow(int color_count) {
+template <typename Mask>
+void OneLineSolver<Mask>::CheckMaxPreferredColorsOverflow(int color_count) {
     if (color_count > kMaxPreferredColorsCount) {
         Logger::get()->warn("Too many colors - {}", color_count);
         Logger::get()->warn("It's recommended to have no more than {} colors",
@@ -42,18 +76,68 @@ void OneLineSolver::CheckMaxPreferredColorsOverflow(int color_count) {
     }
 }
 
-void OneLineSolver::AllocMemory(int side_length) {
-    cache_.resize(side_length + 1);
-    calculated_fill_.resize(side_length + 1);
-    for (int i = 0; i < cache_.size(); ++i) {
-        cache_[i].resize(side_length + 1);
-        calculated_fill_[i].resize(side_length + 1);
+template <typename Mask>
+void OneLineSolver<Mask>::AllocMemory(int side_length, int color_count) {
+    overlap_starts_.resize(side_length);
+    overlap_colors_.resize(color_count);
+    if (engine_ == Engine::kBitset) {
+        bitset_solver_.Init(side_length);
+        return;
+    }
+    if (engine_ == Engine::kRecursive) {
+        // The rows aren't dropped for a shorter side, a reused solver keeps
+        // their memory for the longer ones
+        if (cache_.size() < side_length + 1) {
+            cache_.resize(side_length + 1);
+            calculated_fill_.resize(side_length + 1);
+        }
+        for (int i = 0; i <= side_length; ++i) {
+            cache_[i].resize(side_length + 1);
+            calculated_fill_[i].resize(side_length + 1);
+        }
     }
     result_cells_.resize(side_length);
-    cache_count_ = 0;
+    run_lengths_.resize(color_count * (side_length + 1));
+    run_lengths_built_.assign(color_count, 0);
+    placements_.resize(color_count * (side_length + 1));
+    line_colors_.reserve(color_count);
+    side_length_ = side_length;
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::BuildRunLengths(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells) {
+    line_colors_.clear();
+    BuildRunLength(cells, 0);
+    for (const auto& group : groups) {
+        BuildRunLength(cells, group.second);
+    }
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::BuildRunLength(const vector<Mask>& cells, int color) {
+    if (run_lengths_built_[color] == cache_count_) {
+        return;
+    }
+    run_lengths_built_[color] = cache_count_;
+    line_colors_.push_back(color);
+
+    // Go from the end of the line, every run starting from the Y-th cell
+    // continues the run starting from the (Y + 1)-th cell
+    int len = cells.size();
+    int* run = run_lengths_.data() + color * (side_length_ + 1);
+    Mask mask = ColorMask<Mask>(color);
+    run[len] = 0;
+    for (int i = len - 1; i >= 0; i--) {
+        run[i] = (cells[i] & mask) ? run[i + 1] + 1 : 0;
+    }
+
+    int* placed = placements_.data() + color * (side_length_ + 1);
+    fill(placed, placed + len + 1, 0);
 }
 
-bool OneLineSolver::CanPlaceColor(const vector<int>& cells, int color,
+template <typename Mask>
+bool OneLineSolver<Mask>::CanPlaceColor(const vector<Mask>& cells, int color,
         int lbound, int rbound) {
     // Went out of the border
     if (rbound >= cells.size()) {
@@ -62,25 +146,40 @@ bool OneLineSolver::CanPlaceColor(const vector<int>& cells, int color,
 
     // We can paint a block of cells with a certain color if and only if it is
     // possible for all cells to have this color (that means, if every cell
-    // from the block has color-th bit set to 1)
-    int mask = 1 << color;
-    for (int i = lbound; i <= rbound; ++i) {
-        if (!(cells[i] & mask)) {
-            return false;
-        }
-    }
-    return true;
+    // from the block has color-th bit set to 1), so the run of the color
+    // starting from lbound should cover the block
+    return run_lengths_[color * (side_length_ + 1) + lbound] >=
+        rbound - lbound + 1;
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::SetPlaceColor(int color, int lbound, int rbound) {
+    // Every cell from the block now can have this color, the block is added
+    // to the cells in SweepPlacements()
+    int* placed = placements_.data() + color * (side_length_ + 1);
+    placed[lbound]++;
+    placed[rbound + 1]--;
 }
 
-void OneLineSolver::SetPlaceColor(int color, int lbound, int rbound) {
-    // Every cell from the block now can have this color
-    for (int i = lbound; i <= rbound; ++i) {
-        result_cells_[i] |= (1 << color);
+template <typename Mask>
+void OneLineSolver<Mask>::SweepPlacements(int len) {
+    // A cell can have a color if it's covered by some interval of the color
+    for (int color : line_colors_) {
+        const int* placed = placements_.data() + color * (side_length_ + 1);
+        Mask mask = ColorMask<Mask>(color);
+        int covered = 0;
+        for (int i = 0; i < len; i++) {
+            covered += placed[i];
+            if (covered) {
+                result_cells_[i] |= mask;
+            }
+        }
     }
 }
 
-bool OneLineSolver::CanFill(const vector<pair<int, int>>& groups,
-        const vector<int>& cells, int current_group = 0, int current_cell = 0) {
+template <typename Mask>
+bool OneLineSolver<Mask>::CanFill(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells, int current_group, int current_cell) {
     // If we reached the end of the puzzle, all the groups should have
     // been placed
     if (current_cell == cells.size()) {
@@ -143,40 +242,411 @@ bool OneLineSolver::CanFill(const vector<pair<int, int>>& groups,
     return answer;
 }
 
-void OneLineSolver::DebugLog(const std::vector<std::pair<int, int>>& groups,
-        const std::vector<int>& cells) {
+template <typename Mask>
+int OneLineSolver<Mask>::PlaceGroup(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells, int group, int cell) {
+    int color = groups[group].second;
+    int rbound = cell + groups[group].first - 1;
+    if (!CanPlaceColor(cells, color, cell, rbound)) {
+        return -1;
+    }
+
+    // If the next group color is the same, then we should place a WHITE cell
+    int next_cell = rbound + 1;
+    if (group + 1 < groups.size() && groups[group + 1].second == color) {
+        if (!CanPlaceColor(cells, 0, next_cell, next_cell)) {
+            return -1;
+        }
+        next_cell++;
+    }
+    return next_cell;
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::FindGroupBounds(const vector<pair<int, int>>& groups,
+        int len) {
+    // min_length[X] is the least count of cells used by the first X groups
+    int group_count = groups.size();
+    vector<int>& min_length = group_bounds_;
+    min_length.resize(group_count + 1 + 2 * (len + 1));
+    min_length[0] = 0;
+    for (int group = 0; group < group_count; group++) {
+        bool place_white = group + 1 < group_count &&
+            groups[group + 1].second == groups[group].second;
+        min_length[group + 1] = min_length[group] + groups[group].first +
+            place_white;
+    }
+
+    // The count of the cells that are free to move the groups
+    int slack = len - min_length[group_count];
+    if (slack < 0) {
+        return false;
+    }
+
+    // X groups can be placed before the Y-th cell only if
+    // min_length[X] <= Y <= min_length[X] + slack
+    int* bounds = group_bounds_.data() + group_count + 1;
+    int lower = 0;
+    int upper = 0;
+    for (int cell = 0; cell <= len; cell++) {
+        while (upper < group_count && min_length[upper + 1] <= cell) {
+            upper++;
+        }
+        while (min_length[lower] + slack < cell) {
+            lower++;
+        }
+        bounds[2 * cell] = lower;
+        bounds[2 * cell + 1] = upper;
+    }
+    return true;
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::MarkReachable(int cell, int group, int stride) {
+    int* prefix = reachable_.data() + cell * stride;
+    int& lower = reachable_groups_[2 * cell];
+    int& upper = reachable_groups_[2 * cell + 1];
+
+    // Widen the range of the states stored for the cell, the new states of
+    // the range are unreachable until they are marked
+    if (lower > upper) {
+        lower = upper = group;
+    } else if (group < lower) {
+        fill(prefix + group + 1, prefix + lower, 0);
+        lower = group;
+    } else if (group > upper) {
+        fill(prefix + upper + 1, prefix + group, 0);
+        upper = group;
+    }
+    prefix[group] = 1;
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::CanFillIterative(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells) {
+    int len = cells.size();
+    int group_count = groups.size();
+    int stride = group_count + 1;
+    int states = (len + 1) * stride;
+
+    if (!FindGroupBounds(groups, len)) {
+        return false;
+    }
+    const int* bounds = group_bounds_.data() + group_count + 1;
+
+    // Only grows, so the memory is allocated once for the longest lines
+    if (reachable_.size() < 2 * states) {
+        reachable_.resize(2 * states);
+    }
+    if (reachable_groups_.size() < 2 * (len + 1)) {
+        reachable_groups_.resize(2 * (len + 1));
+    }
+    int* prefix = reachable_.data();
+    int* suffix = reachable_.data() + states;
+
+    // Only the reachable states are looked at, so the buffer doesn't have
+    // to be cleared
+    for (int cell = 0; cell <= len; cell++) {
+        reachable_groups_[2 * cell] = group_count + 1;
+        reachable_groups_[2 * cell + 1] = -1;
+    }
+    const int* marked = reachable_groups_.data();
+
+    // Prefix: which states can be reached from the start of the line. The
+    // states outside the bounds can't reach the end, so they are skipped
+    MarkReachable(0, 0, stride);
+    for (int cell = 0; cell < len; cell++) {
+        bool white = CanPlaceColor(cells, 0, cell, cell);
+        int lower = marked[2 * cell];
+        int upper = marked[2 * cell + 1];
+        for (int group = lower; group <= upper; group++) {
+            if (!prefix[cell * stride + group]) {
+                continue;
+            }
+            if (white && group >= bounds[2 * (cell + 1)]) {
+                MarkReachable(cell + 1, group, stride);
+            }
+            if (group < group_count) {
+                int next_cell = PlaceGroup(groups, cells, group, cell);
+                if (next_cell >= 0 && group + 1 >= bounds[2 * next_cell]) {
+                    MarkReachable(next_cell, group + 1, stride);
+                } else {
+                    next_cell = -1;
+                }
+                // Save the result of the placement for the suffix pass
+                prefix[cell * stride + group] = next_cell + 2;
+            }
+        }
+    }
+
+    // All the groups should have been placed at the end of the line
+    if (marked[2 * len + 1] != group_count) {
+        return false;
+    }
+
+    // Suffix: from which reachable states the end of the line can be reached.
+    // A transition is a part of a correct filling if its source is reachable
+    // from the start and the end is reachable from its target, so the cells
+    // are marked in the same pass
+    fill(suffix + len * stride + marked[2 * len],
+            suffix + len * stride + group_count, 0);
+    suffix[len * stride + group_count] = 1;
+    for (int cell = len - 1; cell >= 0; cell--) {
+        bool white = CanPlaceColor(cells, 0, cell, cell);
+        int lower = marked[2 * cell];
+        int upper = marked[2 * cell + 1];
+        for (int group = lower; group <= upper; group++) {
+            int answer = 0;
+            int reachable = prefix[cell * stride + group];
+            if (!reachable) {
+                suffix[cell * stride + group] = answer;
+                continue;
+            }
+            if (white && group >= bounds[2 * (cell + 1)] &&
+                    suffix[(cell + 1) * stride + group]) {
+                SetPlaceColor(0, cell, cell);
+                answer = 1;
+            }
+            if (group < group_count) {
+                int next_cell = reachable - 2;
+                if (next_cell >= 0 && suffix[next_cell * stride + group + 1]) {
+                    int rbound = cell + groups[group].first - 1;
+                    SetPlaceColor(groups[group].second, cell, rbound);
+                    if (next_cell > rbound + 1) {
+                        SetPlaceColor(0, rbound + 1, rbound + 1);
+                    }
+                    answer = 1;
+                }
+            }
+            suffix[cell * stride + group] = answer;
+        }
+    }
+
+    return suffix[0];
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::DebugLog(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells) {
+    // The lines aren't formatted if the messages are skipped
+    if (NONOGRAMS_LOG_LEVEL > SPDLOG_LEVEL_DEBUG ||
+            !Logger::get()->should_log(spdlog::level::debug)) {
+        return;
+    }
+
     // Log groups
     stringstream ss;
     ss << "Groups: ";
     for (const auto& it : groups) {
         ss << "(" << it.first << ", " << it.second << ") ";
     }
-    Logger::get()->debug(ss.str());
+    LOG_DEBUG(ss.str());
     ss.str("");  // clear stream
 
     // Log cells
     ss << "Cells: ";
-    for (const auto& it : groups) {
-        ss << "(" << it.first << ", " << it.second << ") ";
+    for (const auto& it : cells) {
+        ss << static_cast<uint64_t>(it) << " ";
+    }
+    LOG_DEBUG(ss.str());
+}
+
+template <typename Mask>
+void OneLineSolver<Mask>::MakeCacheKey(const vector<pair<int, int>>& groups,
+        const vector<Mask>& cells) {
+    // The lines of the other mask widths have other keys, even if their bytes
+    // are the same
+    line_cache_key_.clear();
+    line_cache_key_ += static_cast<char>(sizeof(Mask));
+    int group_count = groups.size();
+    line_cache_key_.append(reinterpret_cast<const char*>(&group_count),
+            sizeof(group_count));
+    line_cache_key_.append(reinterpret_cast<const char*>(groups.data()),
+            groups.size() * sizeof(groups[0]));
+    line_cache_key_.append(reinterpret_cast<const char*>(cells.data()),
+            cells.size() * sizeof(Mask));
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::UpdateState(const vector<pair<int, int>>& groups,
+        vector<Mask>& cells, vector<int>* changed) {
+    if (!changed) {
+        return UpdateCells(groups, cells);
+    }
+
+    old_cells_.assign(cells.begin(), cells.end());
+    if (!UpdateCells(groups, cells)) {
+        return false;
+    }
+    changed->clear();
+    for (int i = 0; i < cells.size(); i++) {
+        if (cells[i] != old_cells_[i]) {
+            changed->push_back(i);
+        }
+    }
+    return true;
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::UpdateCells(const vector<pair<int, int>>& groups,
+        vector<Mask>& cells) {
+    if (overlap_ && SolveOverlap(groups, cells)) {
+        overlap_solves_++;
+        return true;
+    }
+
+    if (!line_cache_) {
+        return SolveLine(groups, cells);
+    }
+
+    MakeCacheKey(groups, cells);
+    // The lines which can't be solved are remembered with empty cells, the
+    // search meets them again in other branches
+    if (line_cache_->Find(line_cache_key_, line_cache_cells_)) {
+        if (line_cache_cells_.empty()) {
+            return false;
+        }
+        memcpy(cells.data(), line_cache_cells_.data(),
+                line_cache_cells_.size());
+        return true;
+    }
+
+    if (!SolveLine(groups, cells)) {
+        line_cache_->Insert(line_cache_key_, string());
+        return false;
+    }
+    line_cache_cells_.assign(reinterpret_cast<const char*>(cells.data()),
+            cells.size() * sizeof(Mask));
+    line_cache_->Insert(line_cache_key_, line_cache_cells_);
+    return true;
+}
+
+template <typename Mask>
+bool OneLineSolver<Mask>::SolveOverlap(const vector<pair<int, int>>& groups,
+        vector<Mask>& cells) {
+    int len = cells.size();
+    int group_count = groups.size();
+    if (group_count > len) {
+        return false;
+    }
+
+    // Every cell should be able to have all the colors of the line
+    Mask line_colors = ColorMask<Mask>(0);
+    for (const auto& group : groups) {
+        line_colors |= ColorMask<Mask>(group.second);
+    }
+    for (Mask cell : cells) {
+        if ((cell & line_colors) != line_colors) {
+            return false;
+        }
     }
-    Logger::get()->debug(ss.str());
+
+    // The leftmost placement, the rightmost one is shifted by the slack.
+    // If the groups don't fit, the full solving reports it
+    int* starts = overlap_starts_.data();
+    int pos = 0;
+    for (int group = 0; group < group_count; group++) {
+        if (group > 0 && groups[group - 1].second == groups[group].second) {
+            pos++;
+        }
+        starts[group] = pos;
+        pos += groups[group].first;
+    }
+    int slack = len - pos;
+    if (slack < 0) {
+        return false;
+    }
+
+    // The groups which can cover a cell are the groups [first..last), both
+    // bounds only grow. The places of the forced group overlap on the cells
+    // [start + slack..start + length), these intervals don't intersect
+    int first = 0;
+    int last = 0;
+    int forced = 0;
+    Mask mask = 0;
+    int* color_groups = overlap_colors_.data();
+    for (int i = 0; i < len; i++) {
+        while (last < group_count && starts[last] <= i) {
+            int color = groups[last++].second;
+            if (color_groups[color]++ == 0) {
+                mask |= ColorMask<Mask>(color);
+            }
+        }
+        while (first < last &&
+                starts[first] + slack + groups[first].first <= i) {
+            int color = groups[first++].second;
+            if (--color_groups[color] == 0) {
+                mask &= ~ColorMask<Mask>(color);
+            }
+        }
+        while (forced < group_count &&
+                starts[forced] + groups[forced].first <= i) {
+            forced++;
+        }
+        bool white = forced == group_count || starts[forced] + slack > i;
+        cells[i] = white ? mask | ColorMask<Mask>(0) : mask;
+    }
+
+    // Clear the counts for the next line
+    while (first < last) {
+        color_groups[groups[first++].second]--;
+    }
+    return true;
 }
 
-bool OneLineSolver::UpdateState(const vector<std::pair<int, int>>& groups,
-        vector<int>& cells) {
-    // Update memory
+template <typename Mask>
+bool OneLineSolver<Mask>::SolveLine(const vector<pair<int, int>>& groups,
+        vector<Mask>& cells) {
+    full_solves_++;
+    if (engine_ == Engine::kBitset) {
+        if (!bitset_solver_.UpdateState(groups, cells)) {
+            if (!quiet_) {
+                Logger::get()->error("The puzzle can't be solved due to an "
+                        "incorrect input");
+                DebugLog(groups, cells);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // Update memory. The count keeps growing across the puzzles of a reused
+    // solver, the tables are cleared only when it's about to overflow
+    if (cache_count_ == numeric_limits<int>::max()) {
+        for (auto& row : cache_) {
+            fill(row.begin(), row.end(), 0);
+        }
+        fill(run_lengths_built_.begin(), run_lengths_built_.end(), 0);
+        cache_count_ = 0;
+    }
     cache_count_++;
     fill(result_cells_.begin(), result_cells_.begin() + cells.size(), 0);
+    BuildRunLengths(groups, cells);
 
-    if (!CanFill(groups, cells)) {
-        Logger::get()->error("The puzzle can't be solved due to an incorrect "
-                "input");
-        DebugLog(groups, cells);
+    bool can_fill;
+    if (engine_ == Engine::kIterative) {
+        can_fill = CanFillIterative(groups, cells);
+    } else {
+        can_fill = CanFill(groups, cells);
+    }
+
+    if (!can_fill) {
+        if (!quiet_) {
+            Logger::get()->error("The puzzle can't be solved due to an "
+                    "incorrect input");
+            DebugLog(groups, cells);
+        }
         return false;
     }
 
     // result_cells_ contains the updated state
+    SweepPlacements(cells.size());
     copy(result_cells_.begin(), result_cells_.begin() + cells.size(),
             cells.begin());
     return true;
 }
+
+template class OneLineSolver<uint8_t>;
+template class OneLineSolver<uint16_t>;
+template class OneLineSolver<uint32_t>;
+template class OneLineSolver<uint64_t>;
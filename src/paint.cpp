@@ -5,57 +5,48 @@
 #include <paint.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <utility>
 #include <vector>
 
-#include <arguments.h>
+#include <cell_mask.h>
+#include <frame_buffer.h>
+#include <image_writer.h>
 #include <logger.h>
 #include <puzzle.h>
+#include <solve_options.h>
+#include <thread_pool.h>
 
+#ifndef NONOGRAMS_NO_MAGICK
 #include <Magick++.h>
+#endif
 
+using std::call_once;
 using std::endl;
+using std::function;
 using std::get;
 using std::map;
 using std::max;
+using std::min;
+using std::move;
 using std::ofstream;
+using std::once_flag;
 using std::pair;
 using std::string;
 using std::to_string;
 using std::vector;
 
 
-const char* Paint::kImageExtension = ".png";
 const char* Paint::kGifExtension = ".gif";
-vector<Magick::Image> Paint::gif_frames_ = vector<Magick::Image>();
 
 
 /* Helper functions */
 
-void ImageDrawSquare(Magick::Image& image, const Magick::Color& color,
-        int pos_x, int pos_y, int scale) {
-    for (int i = pos_x * scale; i < (pos_x + 1) * scale; i++) {
-        for (int j = pos_y * scale; j < (pos_y + 1) * scale; j++) {
-            image.pixelColor(j, i, color);
-        }
-    }
-}
-
-void ImageOverlayLine(Magick::Image& image, double multiplier,
-        int start_x, int start_y, int end_x, int end_y) {
-    for (int i = start_x; i <= end_x; i++) {
-        for (int j = start_y; j <= end_y; j++) {
-            Magick::ColorRGB c = image.pixelColor(j, i);
-            Magick::ColorRGB result(c.red() * multiplier,
-                    c.green() * multiplier, c.blue() * multiplier);
-            image.pixelColor(j, i, result);
-        }
-    }
-}
-
 char GetHexSymbol(int v) {
     if (v >= 0 && v <= 9) {
         return static_cast<char>(v + '0');
@@ -85,27 +76,11 @@ string ByteToHex(int v) {
     return hex_str;
 }
 
-string MagickColorToString(const Magick::ColorRGB& color) {
-    int r = ReverseColorByte(color.red());
-    int g = ReverseColorByte(color.green());
-    int b = ReverseColorByte(color.blue());
-    return "#" + ByteToHex(r) + ByteToHex(g) + ByteToHex(b);
-}
-
 int GetRandomNumber() {
     return 4;  // chosen by fair dice roll
                // guaranteed to be random
 }
 
-int GetColorIndex(map<string, int>& color_map, const Magick::Color& color) {
-    string key = MagickColorToString(color);
-    if (!color_map.count(key)) {
-        int size = color_map.size();
-        color_map[key] = size;
-    }
-    return color_map[key];
-}
-
 int GetIntFromHex(const string& hex_str) {
     int f, s;
     if (hex_str[0] >= '0' && hex_str[0] <= '9') {
@@ -121,120 +96,210 @@ int GetIntFromHex(const string& hex_str) {
     return f * 16 + s;
 }
 
-Magick::ColorRGB PuzzleColorToMagick(const Puzzle::Color& source) {
-    double r = static_cast<double>(get<0>(source)) / 255.0;
-    double g = static_cast<double>(get<1>(source)) / 255.0;
-    double b = static_cast<double>(get<2>(source)) / 255.0;
-    return Magick::ColorRGB(r, g, b);
+#ifndef NONOGRAMS_NO_MAGICK
+string MagickColorToString(const Magick::ColorRGB& color) {
+    int r = ReverseColorByte(color.red());
+    int g = ReverseColorByte(color.green());
+    int b = ReverseColorByte(color.blue());
+    return "#" + ByteToHex(r) + ByteToHex(g) + ByteToHex(b);
+}
+
+int GetColorIndex(map<string, int>& color_map, const Magick::Color& color) {
+    string key = MagickColorToString(color);
+    if (!color_map.count(key)) {
+        int size = color_map.size();
+        color_map[key] = size;
+    }
+    return color_map[key];
+}
+
+// ImageMagick takes time to start, so the runs which don't need it (with
+// --benchmark, -e or the built-in image formats) don't initialize it
+static once_flag magick_once;
+
+void InitMagick() {
+    call_once(magick_once, [] { Magick::InitializeMagick(nullptr); });
+}
+
+Magick::Image FrameBufferToMagick(const FrameBuffer& buffer) {
+    InitMagick();
+    return Magick::Image(buffer.width(), buffer.height(), "RGB",
+            Magick::CharPixel, buffer.data());
+}
+
+void DisplayMagick(const FrameBuffer& buffer) {
+    FrameBufferToMagick(buffer).display();
 }
 
+void WriteMagick(const FrameBuffer& buffer, const string& filename) {
+    FrameBufferToMagick(buffer).write(filename);
+}
+
+void WriteMagickGif(const vector<FrameBuffer>& frames, int frame_delay,
+        int end_delay, const string& filename) {
+    // We write a gif if yours Magick++ isn't buggy
+#ifndef BUGGY_MAGIC
+    vector<Magick::Image> images;
+    for (const auto& frame : frames) {
+        images.push_back(FrameBufferToMagick(frame));
+        images.back().animationDelay(frame_delay);
+    }
+    images.back().animationDelay(end_delay);
+    Magick::writeImages(images.begin(), images.end(), filename, true);
+#endif
+}
+#else
+void LogNoMagick(const char* action) {
+    Logger::get()->error("Can't {} without ImageMagick, the program is built "
+            "without it", action);
+}
+
+void DisplayMagick(const FrameBuffer& buffer) {
+    LogNoMagick("display the image");
+}
+
+void WriteMagick(const FrameBuffer& buffer, const string& filename) {
+    LogNoMagick("write the image by ImageMagick");
+}
+
+void WriteMagickGif(const vector<FrameBuffer>& frames, int frame_delay,
+        int end_delay, const string& filename) {
+    LogNoMagick("write the gif");
+}
+#endif  // NONOGRAMS_NO_MAGICK
+
 /* Public functions */
 
-void Paint::WriteImage(Magick::Image& image, int image_counter) {
-    if (cli_args::display) {
+Paint::Paint(const DrawOptions& options) : options_(options) {}
+
+Paint::~Paint() {}
+
+void Paint::WriteImage(const FrameBuffer& buffer, int image_counter) {
+    if (options_.display) {
         if (image_counter) {
             Logger::get()->info("Display image, count {}", image_counter);
         } else {
             Logger::get()->info("Display image");
         }
-        image.display();
-    } else {
-        string filename = GetImageFilename(image_counter);
-        Logger::get()->info("Write image to {}", filename);
-        image.write(filename);
+        DisplayMagick(buffer);
+        return;
+    }
+
+    string filename = GetImageFilename(image_counter);
+    Logger::get()->info("Write image to {}", filename);
+    switch (options_.format) {
+        case ImageFormat::kPng:
+            ImageWriter::WritePng(buffer, filename);
+            break;
+        case ImageFormat::kPpm:
+            ImageWriter::WritePpm(buffer, filename);
+            break;
+        case ImageFormat::kMagick:
+            WriteMagick(buffer, filename);
+            break;
+    }
+}
+
+void Paint::PushGifFrame(FrameBuffer&& buffer) {
+    gif_frames_.push_back(move(buffer));
+}
+
+void Paint::DrawBands(FrameBuffer& buffer,
+        const function<void(FrameBand&)>& draw) const {
+    if (options_.threads == 1 || static_cast<int64_t>(buffer.width()) *
+            buffer.height() < kParallelPixels) {
+        FrameBand band(buffer);
+        draw(band);
+        return;
+    }
+
+    // Every pixel is in one band, so it's drawn in the same order as by
+    // a single thread
+    ThreadPool pool(options_.threads);
+    for (int top = 0; top < buffer.height(); top += kBandRows) {
+        pool.Submit([this, &buffer, &draw, top](int) {
+            FrameBand band(buffer, top, top + kBandRows);
+            draw(band);
+        });
     }
+    pool.Wait();
 }
 
-string Paint::GetImageFilename(int image_counter) {
-    string filename = args::get(cli_args::imageName);
+string Paint::GetImageFilename(int image_counter) const {
+    string filename = options_.image_name;
 
     string counter = to_string(image_counter);
     while (counter.size() < GetRandomNumber()) {
         counter = "0" + counter;
     }
-    filename += counter + string(kImageExtension);
+    filename += counter + string(ImageExtension(options_.format));
     return filename;
 }
 
-string Paint::GetGifFilename() {
-    string filename = args::get(cli_args::imageName);
+string Paint::GetGifFilename() const {
+    string filename = options_.image_name;
     filename += string(kGifExtension);
     return filename;
 }
 
-vector<Magick::ColorRGB> ConvertPuzzleColorsToMagic(
-        const vector<Puzzle::Color>& colors) {
-    vector<Magick::ColorRGB> magic_colors(colors.size());
-    for (int i = 0; i < colors.size(); i++) {
-        magic_colors[i] = PuzzleColorToMagick(colors[i]);
-    }
-    return magic_colors;
-}
-
-Magick::Image Paint::CreateImage(const Puzzle::Config& config) {
+template <typename Mask>
+FrameBuffer Paint::CreateImage(const Puzzle::Config<Mask>& config) {
     auto& n = config.n;
     auto& m = config.m;
     auto& colors = config.colors;
-    auto& row_masks = config.row_masks;
-
-    // Parse puzzle colors to Magick format
-    auto magic_colors = ConvertPuzzleColorsToMagic(colors);
-
-    // Draw the image
-    Magick::Image image(Magick::Geometry(m, n), "white");
-    for (int row = 0; row < n; row++) {
-        for (int col = 0; col < m; col++) {
-            int mask = row_masks[row][col];
-            if (__builtin_popcount(mask) > 1) {
-                image.pixelColor(col, row, "black");
-            } else {
-                int color_index = __builtin_ctz(mask);
-                image.pixelColor(col, row, magic_colors[color_index]);
+    const Puzzle::Color color_unknown(0, 0, 0);
+
+    int scale = max(options_.scale, 1);
+    FrameBuffer buffer(m * scale, n * scale, Puzzle::Color(255, 255, 255));
+    DrawBands(buffer, [&](FrameBand& band) {
+        // The first pixel row of a row of cells is drawn, the next ones are
+        // copied from it
+        for (int row = band.top() / scale; row * scale < band.bottom();
+                row++) {
+            int first = max(row * scale, band.top());
+            for (int col = 0; col < m; col++) {
+                Mask mask = config.cell(row, col);
+                if (CountColors(mask) > 1) {
+                    band.Fill(color_unknown, col * scale, first, scale, 1);
+                } else {
+                    band.Fill(colors[FirstColor(mask)], col * scale, first,
+                            scale, 1);
+                }
+            }
+            for (int y = first + 1; y < (row + 1) * scale; y++) {
+                band.CopyRow(first, y);
             }
         }
-    }
-
-    // scale the image if needed
-    if (cli_args::scaleImage) {
-        int sc = args::get(cli_args::scaleImage);
-        image.scale(Magick::Geometry(sc * m, sc * n));
-    }
-
-    return image;
+    });
+    return buffer;
 }
 
-void Paint::DrawImage(const Puzzle::Config& config, int image_count) {
+template <typename Mask>
+void Paint::DrawImage(const Puzzle::Config<Mask>& config, int image_count) {
     // check for the blocking flag
-    if (cli_args::empty) {
+    if (options_.empty) {
         Logger::get()->info("Don't save the image");
         return;
     }
 
-    auto image = CreateImage(config);
-
-    WriteImage(image, image_count);
+    WriteImage(CreateImage(config), image_count);
 }
 
-Magick::Image Paint::CreateCoolImage(const Puzzle::Config& config) {
+template <typename Mask>
+FrameBuffer Paint::CreateCoolImage(const Puzzle::Config<Mask>& config) {
     auto& n = config.n;
     auto& m = config.m;
     auto& colors = config.colors;
     auto& row_groups = config.row_groups;
     auto& col_groups = config.col_groups;
-    auto& row_masks = config.row_masks;
 
-    // Parse puzzle colors to Magick format
-    auto magic_colors = ConvertPuzzleColorsToMagic(colors);
-
-    auto color_border = PuzzleColorToMagick(Puzzle::ParseColor("#8f8f8f"));
-    auto color_outer_background = PuzzleColorToMagick(
-            Puzzle::ParseColor("#d7d7d7"));
-    auto color_inner_background = PuzzleColorToMagick(
-            Puzzle::ParseColor("#ffffff"));
+    auto color_border = Puzzle::ParseColor("#8f8f8f");
+    auto color_outer_background = Puzzle::ParseColor("#d7d7d7");
+    auto color_inner_background = Puzzle::ParseColor("#ffffff");
 
     int pixelize = 2;
-    if (cli_args::scaleImage) {
-        pixelize = args::get(cli_args::scaleImage);
+    if (options_.scale) {
+        pixelize = options_.scale;
     }
 
     int max_group_count_horizontal = 0;
@@ -262,169 +327,177 @@ Magick::Image Paint::CreateCoolImage(const Puzzle::Config& config) {
                 n + /* config of horizontal groups */
                 1;  /* border */
 
+    // The cells of the layout above are squares of pixelize pixels
+    int width = image_width * pixelize;
+    int height = image_height * pixelize;
+    int groups_left = (max_group_count_horizontal + 2) * pixelize;
+    int groups_top = (max_group_count_vertical + 2) * pixelize;
+
     // init image
-    Magick::Image image(Magick::Geometry(image_width * pixelize,
-                image_height * pixelize),
-                "white");
-    image.type(Magick::TrueColorType);
-
-    // draw horizontal groups
-    for (int i = 0; i < row_groups.size(); i++) {
-        int pos = max_group_count_horizontal - row_groups[i].size() + 1;
-        for (const auto& g : row_groups[i]) {
-            ImageDrawSquare(image, magic_colors[g.second],
-                    i + 2 + max_group_count_vertical, pos, pixelize);
-            pos++;
+    FrameBuffer buffer(width, height, color_inner_background);
+    DrawBands(buffer, [&](FrameBand& band) {
+        auto draw_square = [&](const Puzzle::Color& color, int row, int col) {
+            band.Fill(color, col * pixelize, row * pixelize, pixelize,
+                    pixelize);
+        };
+
+        // draw horizontal groups
+        for (int i = 0; i < row_groups.size(); i++) {
+            int pos = max_group_count_horizontal - row_groups[i].size() + 1;
+            for (const auto& g : row_groups[i]) {
+                draw_square(colors[g.second],
+                        i + 2 + max_group_count_vertical, pos);
+                pos++;
+            }
         }
-    }
 
-    // draw vertical groups
-    for (int i = 0; i < col_groups.size(); i++) {
-        int pos = max_group_count_vertical - col_groups[i].size() + 1;
-        for (const auto& g : col_groups[i]) {
-            ImageDrawSquare(image, magic_colors[g.second], pos,
-                    i + 2 + max_group_count_horizontal, pixelize);
-            pos++;
+        // draw vertical groups
+        for (int i = 0; i < col_groups.size(); i++) {
+            int pos = max_group_count_vertical - col_groups[i].size() + 1;
+            for (const auto& g : col_groups[i]) {
+                draw_square(colors[g.second], pos,
+                        i + 2 + max_group_count_horizontal);
+                pos++;
+            }
         }
-    }
 
-    // draw image solution
-    for (int row = 0; row < n; row++) {
-        for (int col = 0; col < m; col++) {
-            int mask = row_masks[row][col];
-            if (__builtin_popcount(mask) > 1) {
-                continue;  // Draw nothing if haven't solved this pixel
+        // draw image solution, only the rows of the band
+        int first_row = max(0, (band.top() - groups_top) / pixelize);
+        int last_row = min(n, (band.bottom() - groups_top) / pixelize + 1);
+        for (int row = first_row; row < last_row; row++) {
+            for (int col = 0; col < m; col++) {
+                Mask mask = config.cell(row, col);
+                if (CountColors(mask) > 1) {
+                    continue;  // Draw nothing if haven't solved this pixel
+                }
+                int color_index = FirstColor(mask);
+                draw_square(colors[color_index],
+                        row + 2 + max_group_count_vertical,
+                        col + 2 + max_group_count_horizontal);
             }
-            int color_index = __builtin_ctz(mask);
-            ImageDrawSquare(image, magic_colors[color_index],
-                    row + 2 + max_group_count_vertical,
-                    col + 2 + max_group_count_horizontal, pixelize);
         }
-    }
 
-    // draw separators
-    // soft separators
-    for (int row = 0; row < n; row++) {
-        ImageOverlayLine(image, 0.9f, pixelize *
-                    (row + 2 + max_group_count_vertical),
-                0, pixelize * (row + 2 + max_group_count_vertical),
-                image_width * pixelize - 1);
-    }
-    for (int col = 0; col < m; col++) {
-        ImageOverlayLine(image, 0.9f, 0, pixelize *
-                    (col + 2 + max_group_count_horizontal),
-                image_height * pixelize - 1, pixelize *
-                    (col + 2 + max_group_count_horizontal));
-    }
-
-    // group separators
-    for (int i = 0; i < max_group_count_horizontal; i++) {
-        ImageOverlayLine(image, 0.9f, pixelize * (2 + max_group_count_vertical),
-                pixelize * (i + 1), image_height * pixelize - 1,
-                pixelize * (i + 1));
-    }
-    for (int i = 0; i < max_group_count_vertical; i++) {
-        ImageOverlayLine(image, 0.9f, pixelize * (i + 1),
-                pixelize * (2 + max_group_count_horizontal), pixelize * (i + 1),
-                image_width * pixelize - 1);
-    }
+        // draw separators
+        // soft separators
+        for (int row = 0; row < n; row++) {
+            band.Darken(0.9, 0, groups_top + row * pixelize, width, 1);
+        }
+        for (int col = 0; col < m; col++) {
+            band.Darken(0.9, groups_left + col * pixelize, 0, 1, height);
+        }
 
+        // group separators
+        for (int i = 0; i < max_group_count_horizontal; i++) {
+            band.Darken(0.9, pixelize * (i + 1), groups_top, 1,
+                    height - groups_top);
+        }
+        for (int i = 0; i < max_group_count_vertical; i++) {
+            band.Darken(0.9, groups_left, pixelize * (i + 1),
+                    width - groups_left, 1);
+        }
 
-    // 5-separators
-    for (int row = 0; row < n; row += 5) {
-        ImageOverlayLine(image, 0.9f, pixelize *
-                    (row + 2 + max_group_count_vertical),
-                0, pixelize * (row + 2 + max_group_count_vertical),
-                image_width * pixelize - 1);
-    }
-    for (int col = 0; col < m; col += 5) {
-        ImageOverlayLine(image, 0.9f, 0, pixelize *
-                    (col + 2 + max_group_count_horizontal),
-                image_height * pixelize - 1, pixelize *
-                    (col + 2 + max_group_count_horizontal));
-    }
+        // 5-separators
+        for (int row = 0; row < n; row += 5) {
+            band.Darken(0.9, 0, groups_top + row * pixelize, width, 1);
+        }
+        for (int col = 0; col < m; col += 5) {
+            band.Darken(0.9, groups_left + col * pixelize, 0, 1, height);
+        }
 
-    // draw borders
-    for (int i = 0; i < image_height; i++) {
+        // draw borders
         // vertical borders
-        ImageDrawSquare(image, color_border, i, 0, pixelize);
-        ImageDrawSquare(image, color_border, i, max_group_count_horizontal + 1,
-                pixelize);
-        ImageDrawSquare(image, color_border, i, image_width - 1, pixelize);
-    }
-    for (int i = 0; i < image_width; i++) {
+        band.Fill(color_border, 0, 0, pixelize, height);
+        band.Fill(color_border, groups_left - pixelize, 0, pixelize, height);
+        band.Fill(color_border, width - pixelize, 0, pixelize, height);
         // horizontal borders
-        ImageDrawSquare(image, color_border, 0, i, pixelize);
-        ImageDrawSquare(image, color_border, max_group_count_vertical + 1, i,
-                pixelize);
-        ImageDrawSquare(image, color_border, image_height - 1, i, pixelize);
-    }
+        band.Fill(color_border, 0, 0, width, pixelize);
+        band.Fill(color_border, 0, groups_top - pixelize, width, pixelize);
+        band.Fill(color_border, 0, height - pixelize, width, pixelize);
 
-    // draw inner background
-    for (int i = 1; i <= max_group_count_vertical; i++) {
-        for (int j = 1; j <= max_group_count_horizontal; j++) {
-            ImageDrawSquare(image, color_outer_background, i, j, pixelize);
-        }
-    }
+        // draw inner background
+        band.Fill(color_outer_background, pixelize, pixelize,
+                max_group_count_horizontal * pixelize,
+                max_group_count_vertical * pixelize);
+    });
 
-    return image;
+    return buffer;
 }
 
-void Paint::DrawCoolImage(const Puzzle::Config& config, int image_counter) {
+template <typename Mask>
+void Paint::DrawCoolImage(const Puzzle::Config<Mask>& config,
+        int image_counter) {
     // Check for the blocking flag
-    if (cli_args::empty) {
+    if (options_.empty) {
         Logger::get()->info("Don't save the image");
         return;
     }
 
-    auto image = CreateCoolImage(config);
-
-    WriteImage(image, image_counter);
+    WriteImage(CreateCoolImage(config), image_counter);
 }
 
-void Paint::PushCoolFrame(const Puzzle::Config& config) {
+template <typename Mask>
+void Paint::PushCoolFrame(const Puzzle::Config<Mask>& config) {
     // Check for the blocking flag
-    if (cli_args::empty) {
+    if (options_.empty) {
         Logger::get()->info("Don't save the image");
         return;
     }
 
-    auto image = CreateCoolImage(config);
-    image.animationDelay(args::get(cli_args::gif_frame_delay));
-
-    gif_frames_.push_back(image);
+    PushGifFrame(CreateCoolImage(config));
 }
 
-void Paint::PushFrame(const Puzzle::Config& config) {
+template <typename Mask>
+void Paint::PushFrame(const Puzzle::Config<Mask>& config) {
     // Check for the blocking flag
-    if (cli_args::empty) {
+    if (options_.empty) {
         Logger::get()->info("Don't save the image");
         return;
     }
 
-    auto image = CreateImage(config);
-    image.animationDelay(args::get(cli_args::gif_frame_delay));
-
-    gif_frames_.push_back(image);
+    PushGifFrame(CreateImage(config));
 }
 
+// The puzzles may have the cells of every mask type
+template void Paint::DrawCoolImage(const Puzzle::Config<uint8_t>& config,
+        int image_count);
+template void Paint::DrawImage(const Puzzle::Config<uint8_t>& config,
+        int image_count);
+template void Paint::PushCoolFrame(const Puzzle::Config<uint8_t>& config);
+template void Paint::PushFrame(const Puzzle::Config<uint8_t>& config);
+template void Paint::DrawCoolImage(const Puzzle::Config<uint16_t>& config,
+        int image_count);
+template void Paint::DrawImage(const Puzzle::Config<uint16_t>& config,
+        int image_count);
+template void Paint::PushCoolFrame(const Puzzle::Config<uint16_t>& config);
+template void Paint::PushFrame(const Puzzle::Config<uint16_t>& config);
+template void Paint::DrawCoolImage(const Puzzle::Config<uint32_t>& config,
+        int image_count);
+template void Paint::DrawImage(const Puzzle::Config<uint32_t>& config,
+        int image_count);
+template void Paint::PushCoolFrame(const Puzzle::Config<uint32_t>& config);
+template void Paint::PushFrame(const Puzzle::Config<uint32_t>& config);
+template void Paint::DrawCoolImage(const Puzzle::Config<uint64_t>& config,
+        int image_count);
+template void Paint::DrawImage(const Puzzle::Config<uint64_t>& config,
+        int image_count);
+template void Paint::PushCoolFrame(const Puzzle::Config<uint64_t>& config);
+template void Paint::PushFrame(const Puzzle::Config<uint64_t>& config);
+
 void Paint::ReleaseFrames() {
     if (!gif_frames_.empty()) {
         string filename = GetGifFilename();
         Logger::get()->info("Save gif image to {}", filename);
-        gif_frames_.back().animationDelay(args::get(cli_args::gif_frame_delay));
-
-        // We write a gif if yours Magick++ isn't buggy
-#ifndef BUGGY_MAGIC
-        Magick::writeImages(gif_frames_.begin(), gif_frames_.end(),
-                filename, true);
-#endif
-
+        WriteMagickGif(gif_frames_, options_.gif_frame_delay,
+                options_.gif_end_delay, filename);
         gif_frames_.clear();
     }
 }
 
 void Paint::EncodeImage(const string& image_path, const string& filename) {
+#ifdef NONOGRAMS_NO_MAGICK
+    LogNoMagick("read the image");
+#else
+    InitMagick();
     Magick::Image img;
     try {
         img.read(image_path);
@@ -545,5 +618,5 @@ void Paint::EncodeImage(const string& image_path, const string& filename) {
     fout << endl;
 
     fout.close();
+#endif  // NONOGRAMS_NO_MAGICK
 }
-
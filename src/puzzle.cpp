@@ -5,144 +5,460 @@
 #include <puzzle.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <list>
-#include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <utility>
 
-#include <arguments.h>
+#include <cell_mask.h>
+#include <compiled_puzzle.h>
+#include <line_cache.h>
 #include <logger.h>
+#include <mapped_file.h>
 #include <one_line_solver.h>
 #include <paint.h>
+#include <thread_pool.h>
 
-#include <Magick++.h>
-
-using std::ifstream;
-using std::list;
+using std::atomic;
+using std::get;
+using std::lock_guard;
+using std::make_shared;
 using std::make_tuple;
-using std::map;
+using std::make_unique;
 using std::max;
+using std::min;
+using std::move;
+using std::mutex;
+using std::ofstream;
 using std::pair;
+using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 
 Puzzle::Color Puzzle::ParseColor(const string& hex_color) {
+    return ParseColor(hex_color.data(), hex_color.size());
+}
+
+Puzzle::Color Puzzle::ParseColor(const char* hex_color, size_t length) {
     // #ff0f00 -> (255, 15, 0)
-    if (hex_color.size() != 7 || hex_color[0] != '#') {
-        Logger::get()->warn("Strange color found: {}", hex_color);
+    bool valid = length == 7 && hex_color[0] == '#';
+    int value = 0;
+    for (int i = 1; valid && i < length; i++) {
+        char c = hex_color[i];
+        if (c >= '0' && c <= '9') {
+            value = value * 16 + c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value = value * 16 + c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value = value * 16 + c - 'A' + 10;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        Logger::get()->warn("Strange color found: {}",
+                string(hex_color, length));
         Logger::get()->warn("Colors should look like \"#d7e41a\"");
         return make_tuple(0, 0, 0);
     }
-    uint8_t r = stoul(hex_color.substr(1, 2), nullptr, 16);
-    uint8_t g = stoul(hex_color.substr(3, 2), nullptr, 16);
-    uint8_t b = stoul(hex_color.substr(5, 2), nullptr, 16);
-    return make_tuple(r, g, b);
+    return make_tuple(value >> 16, (value >> 8) & 0xff, value & 0xff);
 }
 
-bool Puzzle::ReadColorsFromStream(ifstream& fin) {
-    if (!(fin >> config_.color_count)) {
+Puzzle::Puzzle() : Puzzle(SolveOptions()) {}
+
+Puzzle::Puzzle(const SolveOptions& options) : options_(options),
+        own_context_(make_unique<SolverContext>()),
+        context_(own_context_.get()) {}
+
+Puzzle::Puzzle(const SolveOptions& options, SolverContext* context)
+        : options_(options), context_(context) {}
+
+Puzzle::~Puzzle() {}
+
+bool Puzzle::ReadColors(TextScanner& scanner) {
+    Description& description = context_->description;
+    // The white color is added to the ones of the file, every color takes
+    // a bit of the widest mask
+    if (!scanner.ReadInt(description.color_count) ||
+            description.color_count < 0 ||
+            description.color_count >= MaxMaskColors<uint64_t>()) {
         return false;
     }
 
-    config_.color_count++;  // Add default white color
-    config_.colors.resize(config_.color_count);
-    for (int i = 0; i < config_.color_count; i++) {
-        string color;
-        if (i > 0) {
-            if (!(fin >> color)) {
-                return false;
-            }
-        } else {
-            // The first color is always white
-            color = "#ffffff";
+    description.color_count++;  // Add default white color
+    description.colors.resize(description.color_count);
+    // The first color is always white
+    description.colors[0] = ParseColor("#ffffff");
+    for (int i = 1; i < description.color_count; i++) {
+        const char* color;
+        size_t length;
+        if (!scanner.ReadWord(color, length)) {
+            return false;
         }
-        config_.colors[i] = ParseColor(color);
+        description.colors[i] = ParseColor(color, length);
     }
 
     return true;
 }
 
-vector<vector<pair<int, int>>> Puzzle::ReadGroupInfoColored(ifstream& fin,
-        map<Color, int>& color_map, int length) {
-    vector<vector<pair<int, int>>> res(length);
+void Puzzle::BuildColorTable() {
+    const vector<Color>& colors = context_->description.colors;
+    auto& table = context_->color_table;
+
+    // At most a half of the pairs are used, so the probes are short
+    size_t size = kMinColorTableSize;
+    while (size < 2 * colors.size()) {
+        size *= 2;
+    }
+    table.assign(size, {-1, 0});
+
+    // The later colors replace the earlier ones with the same value
+    for (int i = 0; i < colors.size(); i++) {
+        int value = (get<0>(colors[i]) << 16) | (get<1>(colors[i]) << 8) |
+            get<2>(colors[i]);
+        size_t pos = (value * kColorHashMultiplier >> 16) & (size - 1);
+        while (table[pos].first != -1 && table[pos].first != value) {
+            pos = (pos + 1) & (size - 1);
+        }
+        table[pos] = {value, i};
+    }
+}
+
+int Puzzle::FindColor(int r, int g, int b) const {
+    const auto& table = context_->color_table;
+    // The components are taken modulo 256 like the ones of Color
+    int value = ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
+    size_t pos = (value * kColorHashMultiplier >> 16) & (table.size() - 1);
+    while (table[pos].first != -1) {
+        if (table[pos].first == value) {
+            return table[pos].second;
+        }
+        pos = (pos + 1) & (table.size() - 1);
+    }
+    return 0;
+}
+
+void Puzzle::ResizeGroups(int length, vector<vector<pair<int, int>>>& groups,
+        vector<vector<pair<int, int>>>& spare) {
+    while (groups.size() > length) {
+        spare.push_back(move(groups.back()));
+        groups.pop_back();
+    }
+    while (groups.size() < length) {
+        if (spare.empty()) {
+            groups.emplace_back();
+        } else {
+            groups.push_back(move(spare.back()));
+            spare.pop_back();
+        }
+    }
+}
+
+void Puzzle::CopyDescription(const Description& from, Description& to) {
+    to.filename.assign(from.filename);
+    to.n = from.n;
+    to.m = from.m;
+    to.color_count = from.color_count;
+    to.colors.assign(from.colors.begin(), from.colors.end());
+    ResizeGroups(from.n, to.row_groups, to.spare_row_groups);
+    for (int i = 0; i < from.n; i++) {
+        to.row_groups[i].assign(from.row_groups[i].begin(),
+                from.row_groups[i].end());
+    }
+    ResizeGroups(from.m, to.col_groups, to.spare_col_groups);
+    for (int i = 0; i < from.m; i++) {
+        to.col_groups[i].assign(from.col_groups[i].begin(),
+                from.col_groups[i].end());
+    }
+}
+
+bool Puzzle::ReadGroupInfoColored(TextScanner& scanner, int length,
+        int line_length, vector<vector<pair<int, int>>>& groups,
+        vector<vector<pair<int, int>>>& spare) {
+    // An empty table isn't a puzzle
+    if (length <= 0) {
+        return false;
+    }
+    ResizeGroups(length, groups, spare);
     for (int row = 0; row < length; row++) {
+        // Every group takes a cell at least
         int group_size;
-        if (!(fin >> group_size)) {
-            return {};
-        }
-        if (group_size) {
-            res[row].resize(group_size);
-            for (int group = 0; group < group_size; group++) {
-                int length, r, g, b;
-                if (!(fin >> length >> r >> g >> b)) {
-                    return {};
-                }
-                res[row][group] = {length, color_map[make_tuple(r, g, b)]};
+        if (!scanner.ReadInt(group_size) || group_size < 0 ||
+                group_size > line_length) {
+            return false;
+        }
+        groups[row].resize(group_size);
+        for (int group = 0; group < group_size; group++) {
+            int length, r, g, b;
+            if (!scanner.ReadInt(length) || !scanner.ReadInt(r) ||
+                    !scanner.ReadInt(g) || !scanner.ReadInt(b) ||
+                    length <= 0) {
+                return false;
             }
+            groups[row][group] = {length, FindColor(r, g, b)};
         }
     }
-    return res;
+    return true;
 }
 
-vector<vector<pair<int, int>>> Puzzle::ReadGroupInfoBlack(ifstream& fin,
-        int length) {
-    vector<vector<pair<int, int>>> res(length);
+bool Puzzle::ReadGroupInfoBlack(TextScanner& scanner, int length,
+        int line_length, vector<vector<pair<int, int>>>& groups,
+        vector<vector<pair<int, int>>>& spare) {
+    // An empty table isn't a puzzle
+    if (length <= 0) {
+        return false;
+    }
+    ResizeGroups(length, groups, spare);
     for (int row = 0; row < length; row++) {
+        // Every group takes a cell at least
         int group_size;
-        if (!(fin >> group_size)) {
-            return {};
-        }
-        if (group_size) {
-            res[row].resize(group_size);
-            for (int group = 0; group < group_size; group++) {
-                int length;
-                if (!(fin >> length)) {
-                    return {};
-                }
-                res[row][group] = {length, 1};  // 1 is BLACK color
+        if (!scanner.ReadInt(group_size) || group_size < 0 ||
+                group_size > line_length) {
+            return false;
+        }
+        groups[row].resize(group_size);
+        for (int group = 0; group < group_size; group++) {
+            int length;
+            if (!scanner.ReadInt(length) || length <= 0) {
+                return false;
             }
+            groups[row][group] = {length, 1};  // 1 is BLACK color
         }
     }
-    return res;
+    return true;
 }
 
-bool Puzzle::ReadColored(const string& filename) {
-    ifstream fin(filename);
+const char* Puzzle::kCompiledExtension = ".pzb";
+
+bool Puzzle::IsCompiled(const string& filename) {
+    size_t length = strlen(kCompiledExtension);
+    return filename.size() >= length && filename.compare(
+            filename.size() - length, length, kCompiledExtension) == 0;
+}
 
-    if (!fin) {
+bool Puzzle::ReadCompiled(const string& filename) {
+    MappedFile file;
+    if (!file.Open(filename)) {
         Logger::get()->error("Can't open file {}", filename);
         return false;
     }
+    return ReadCompiled(file.data(), file.size());
+}
 
-    map<Color, int> color_indices;
+bool Puzzle::ReadCompiled(const char* data, size_t size) {
+    // Check the header before looking at the sections
+    CompiledHeader header;
+    if (size < sizeof(header)) {
+        Logger::get()->error("The file is too short for the header");
+        return false;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+        Logger::get()->error("The compiled puzzle isn't aligned in the "
+                "memory");
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "PZB", 4) != 0 ||
+            header.version != kCompiledVersion) {
+        Logger::get()->error("The file isn't a compiled puzzle of version {}",
+                kCompiledVersion);
+        return false;
+    }
+    CompiledLayout layout(header);
+    if (header.rows == 0 || header.columns == 0 || header.color_count == 0 ||
+            header.rows > kMaxCompiledLength ||
+            header.columns > kMaxCompiledLength ||
+            header.color_count > kMaxCompiledColors ||
+            size != layout.size) {
+        Logger::get()->error("The header doesn't match the file size");
+        return false;
+    }
 
-    // Read colors
-    if (!ReadColorsFromStream(fin)) {
-        Logger::get()->error("Error while reading colors from file");
+    Description& description = context_->description;
+    description.n = header.rows;
+    description.m = header.columns;
+    description.color_count = header.color_count;
+    description.colors.resize(header.color_count);
+    const uint8_t* palette = reinterpret_cast<const uint8_t*>(data +
+            layout.palette);
+    for (int i = 0; i < header.color_count; i++) {
+        description.colors[i] = make_tuple(palette[3 * i],
+                palette[3 * i + 1], palette[3 * i + 2]);
+    }
+
+    // The sections are aligned, so the arrays are read in place
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(
+            data + layout.offsets);
+    const uint16_t* lengths = reinterpret_cast<const uint16_t*>(
+            data + layout.lengths);
+    const uint8_t* colors = reinterpret_cast<const uint8_t*>(
+            data + layout.colors);
+    if (offsets[0] != 0 ||
+            offsets[header.rows + header.columns] != header.group_count) {
+        Logger::get()->error("The offsets don't match the groups count");
         return false;
     }
+    ResizeGroups(description.n, description.row_groups,
+            description.spare_row_groups);
+    ResizeGroups(description.m, description.col_groups,
+            description.spare_col_groups);
+    for (int line = 0; line < description.n + description.m; line++) {
+        auto& groups = line < description.n ? description.row_groups[line] :
+            description.col_groups[line - description.n];
+        if (offsets[line + 1] < offsets[line] ||
+                offsets[line + 1] > header.group_count) {
+            Logger::get()->error("The offsets of the line {} are wrong", line);
+            return false;
+        }
+        // The groups must fit the line like the ones of a text puzzle, the
+        // groups of the same color have a cell between them
+        int line_length = line < description.n ? description.m :
+            description.n;
+        int min_length = 0;
+        groups.resize(offsets[line + 1] - offsets[line]);
+        for (int i = 0, group = offsets[line]; i < groups.size();
+                i++, group++) {
+            if (colors[group] >= header.color_count) {
+                Logger::get()->error("Unknown color of the line {}", line);
+                return false;
+            }
+            if (lengths[group] == 0 || lengths[group] > line_length) {
+                Logger::get()->error("The group length {} of the line {} is "
+                        "wrong", lengths[group], line);
+                return false;
+            }
+            min_length += lengths[group];
+            if (i > 0 && colors[group] == colors[group - 1]) {
+                min_length++;
+            }
+            if (min_length > line_length) {
+                Logger::get()->error("The groups of the line {} don't fit it",
+                        line);
+                return false;
+            }
+            groups[i] = {lengths[group], colors[group]};
+        }
+    }
+    return true;
+}
+
+bool Puzzle::WriteCompiled(const string& filename) const {
+    const Description& description = context_->description;
+    int line_count = description.n + description.m;
+    if (max(description.n, description.m) > kMaxCompiledLength ||
+            description.color_count > kMaxCompiledColors) {
+        Logger::get()->error("The puzzle is too big for the compiled format");
+        return false;
+    }
+
+    // The offsets are counted first, they give the size of the file
+    CompiledHeader header;
+    memcpy(header.magic, "PZB", 4);
+    header.version = kCompiledVersion;
+    header.rows = description.n;
+    header.columns = description.m;
+    header.color_count = description.color_count;
+    header.group_count = 0;
+    vector<uint32_t> offsets(line_count + 1);
+    for (int line = 0; line < line_count; line++) {
+        const auto& groups = line < description.n ?
+            description.row_groups[line] :
+            description.col_groups[line - description.n];
+        offsets[line] = header.group_count;
+        header.group_count += groups.size();
+        // The lengths are written as 16-bit numbers
+        for (const auto& group : groups) {
+            if (group.first < 1 || group.first > kMaxCompiledLength) {
+                Logger::get()->error("The group length {} of the line {} "
+                        "can't be compiled", group.first, line);
+                return false;
+            }
+        }
+    }
+    offsets[line_count] = header.group_count;
 
-    for (int i = 0; i < config_.color_count; i++) {
-        color_indices[config_.colors[i]] = i;
+    CompiledLayout layout(header);
+    vector<char> data(layout.size);
+    memcpy(data.data(), &header, sizeof(header));
+    uint8_t* palette = reinterpret_cast<uint8_t*>(data.data() +
+            layout.palette);
+    for (int i = 0; i < description.color_count; i++) {
+        palette[3 * i] = get<0>(description.colors[i]);
+        palette[3 * i + 1] = get<1>(description.colors[i]);
+        palette[3 * i + 2] = get<2>(description.colors[i]);
+    }
+    memcpy(data.data() + layout.offsets, offsets.data(),
+            offsets.size() * sizeof(uint32_t));
+    uint16_t* lengths = reinterpret_cast<uint16_t*>(data.data() +
+            layout.lengths);
+    uint8_t* colors = reinterpret_cast<uint8_t*>(data.data() +
+            layout.colors);
+    for (int line = 0; line < line_count; line++) {
+        const auto& groups = line < description.n ?
+            description.row_groups[line] :
+            description.col_groups[line - description.n];
+        for (const auto& group : groups) {
+            *lengths++ = group.first;
+            *colors++ = group.second;
+        }
+    }
+
+    ofstream fout(filename, ofstream::binary);
+    if (!fout.write(data.data(), data.size())) {
+        Logger::get()->error("Can't write file {}", filename);
+        return false;
+    }
+    return true;
+}
+
+bool Puzzle::ReadColored(const string& filename) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        Logger::get()->error("Can't open file {}", filename);
+        return false;
+    }
+    return ReadColored(file.data(), file.size());
+}
+
+bool Puzzle::ReadColored(const char* data, size_t size) {
+    TextScanner scanner(data, size);
+    Description& description = context_->description;
+
+    // Read colors
+    if (!ReadColors(scanner)) {
+        Logger::get()->error("Error while reading colors from file");
+        return false;
     }
+    BuildColorTable();
 
     // Read the table
-    if (!(fin >> config_.n >> config_.m)) {
+    if (!scanner.ReadInt(description.n) || !scanner.ReadInt(description.m)) {
         Logger::get()->error("Can't read the puzzle dimensions");
         return false;
     }
+    if (description.n > kMaxLength || description.m > kMaxLength) {
+        Logger::get()->error("The puzzle is bigger than {}x{}", kMaxLength,
+                kMaxLength);
+        return false;
+    }
 
-    config_.row_groups = ReadGroupInfoColored(fin, color_indices, config_.n);
-    if (config_.row_groups.empty()) {
+    if (!ReadGroupInfoColored(scanner, description.n, description.m,
+                description.row_groups, description.spare_row_groups)) {
         Logger::get()->error("Can't read the puzzle rows groups");
         return false;
     }
 
-    config_.col_groups = ReadGroupInfoColored(fin, color_indices, config_.m);
-    if (config_.col_groups.empty()) {
+    if (!ReadGroupInfoColored(scanner, description.m, description.n,
+                description.col_groups, description.spare_col_groups)) {
         Logger::get()->error("Can't read the puzzle columns groups");
         return false;
     }
@@ -151,33 +467,43 @@ bool Puzzle::ReadColored(const string& filename) {
 }
 
 bool Puzzle::ReadBlack(const string& filename) {
-    ifstream fin(filename);
-
-    if (!fin) {
+    MappedFile file;
+    if (!file.Open(filename)) {
         Logger::get()->error("Can't open file {}", filename);
         return false;
     }
+    return ReadBlack(file.data(), file.size());
+}
+
+bool Puzzle::ReadBlack(const char* data, size_t size) {
+    TextScanner scanner(data, size);
+    Description& description = context_->description;
 
     // Set colors (only two - white and black)
-    config_.color_count = 2;
-    config_.colors.resize(config_.color_count);
-    config_.colors[0] = ParseColor("#ffffff");
-    config_.colors[1] = ParseColor("#000000");
+    description.color_count = 2;
+    description.colors.resize(description.color_count);
+    description.colors[0] = ParseColor("#ffffff");
+    description.colors[1] = ParseColor("#000000");
 
     // Read the table
-    if (!(fin >> config_.n >> config_.m)) {
+    if (!scanner.ReadInt(description.n) || !scanner.ReadInt(description.m)) {
         Logger::get()->error("Can't read the puzzle dimensions");
         return false;
     }
+    if (description.n > kMaxLength || description.m > kMaxLength) {
+        Logger::get()->error("The puzzle is bigger than {}x{}", kMaxLength,
+                kMaxLength);
+        return false;
+    }
 
-    config_.row_groups = ReadGroupInfoBlack(fin, config_.n);
-    if (config_.row_groups.empty()) {
+    if (!ReadGroupInfoBlack(scanner, description.n, description.m,
+                description.row_groups, description.spare_row_groups)) {
         Logger::get()->error("Can't read the puzzle rows groups");
         return false;
     }
 
-    config_.col_groups = ReadGroupInfoBlack(fin, config_.m);
-    if (config_.col_groups.empty()) {
+    if (!ReadGroupInfoBlack(scanner, description.m, description.n,
+                description.col_groups, description.spare_col_groups)) {
         Logger::get()->error("Can't read the puzzle columns groups");
         return false;
     }
@@ -185,192 +511,661 @@ bool Puzzle::ReadBlack(const string& filename) {
     return true;
 }
 
-bool Puzzle::CheckUniqieness() {
-    auto& row_masks = config_.row_masks;
-    for (int row = 0; row < config_.n; row++) {
-        for (int col = 0; col < config_.m; col++) {
-            // Check if the value has 1 bit
-            if (__builtin_popcount(row_masks[row][col]) != 1) {
-                Logger::get()->error("The puzzle has no analytical solution!");
-                return false;
-            }
-        }
+template <typename Mask>
+bool Puzzle::CheckUniqieness(const Config<Mask>& config) {
+    // Check if every value has 1 bit
+    if (CountUnknownCells(config.cells.data(), config.cells.size()) != 0) {
+        Logger::get()->error("The puzzle has no analytical solution!");
+        return false;
     }
     return true;
 }
 
-int64_t Puzzle::UpdateCellValues() {
-    uint64_t sum = 0;
-    auto& row_masks = config_.row_masks;
-    auto& col_masks = config_.col_masks;
-    for (int row = 0; row < config_.n; row++) {
-        for (int col = 0; col < config_.m; col++) {
-            row_masks[row][col] &= col_masks[col][row];
-            col_masks[col][row] &= row_masks[row][col];
-            sum += row_masks[row][col];
-        }
+template <typename Mask>
+void Puzzle::DrawImage(const Config<Mask>& config) {
+    const DrawOptions& draw = options_.draw;
+    if (!draw.enabled) {
+        return;
     }
-    return sum;
-}
-
-void Puzzle::DrawImage() {
-    if (cli_args::gif) {
-        list<Magick::Image> gif_frames_;
-        if (cli_args::cool) {
-            Paint::PushCoolFrame(config_);
+    // Nothing is drawn, so the Paint and its buffers aren't made
+    if (draw.empty) {
+        Logger::get()->info("Don't save the image");
+        return;
+    }
+    if (!paint_) {
+        paint_ = make_unique<Paint>(draw);
+    }
+    if (draw.gif) {
+        if (draw.cool) {
+            paint_->PushCoolFrame(config);
         } else {
-            Paint::PushFrame(config_);
+            paint_->PushFrame(config);
         }
     } else {
-        if (cli_args::cool) {
-            Paint::DrawCoolImage(config_, image_count_++);
+        if (draw.cool) {
+            paint_->DrawCoolImage(config, image_count_++);
         } else {
-            Paint::DrawImage(config_, image_count_++);
+            paint_->DrawImage(config, image_count_++);
         }
     }
 }
 
-bool Puzzle::UpdateGroupsState(OneLineSolver& solver, vector<int8_t>& dead,
-        vector<vector<pair<int, int>>>& groups, vector<vector<int>>& masks) {
-    int len = groups.size();
+template <typename Mask>
+bool Puzzle::UpdateState(Config<Mask>& config, Propagation<Mask>& propagation,
+        bool quiet) {
+    // The images of --extra-moves are drawn after every line
+    if (propagation.heuristic == LineScheduler::Heuristic::kSweep &&
+            !options_.draw.extra_moves) {
+        return UpdateStateSweeps(config, propagation, quiet);
+    }
 
-    int extra_move_count = 0;
+    auto& solver = propagation.workers[0].solver;
+    auto& scheduler = propagation.scheduler;
+    auto& line_cells = propagation.workers[0].block_cells[0];
+    auto& changed_cells = propagation.workers[0].changed_cells;
+    int n = config.n;
+    int line;
+    bool new_step;
+    while (scheduler.Pop(line, new_step)) {
+        if (propagation.line_solves % kDeadlineCheckSolves == 0 &&
+                OutOfTime()) {
+            return false;
+        }
 
-    for (int i = 0; i < len; i++) {
-        if (!dead[i]) {
-            if (cli_args::extra_moves) {
-                UpdateCellValues();
-                extra_move_count = 0;
-                for (const auto& it : masks[i]) {
-                    if (__builtin_popcount(it) == 1) {
-                        extra_move_count++;
-                    }
-                }
-            }
+        // Draw the current step if needed
+        if (options_.draw.moves && new_step && !quiet) {
+            DrawImage(config);
+        }
 
-            if (!solver.UpdateState(groups[i], masks[i])) {
+        // The rows are the lines [0..n), the columns are the lines [n..n+m)
+        bool is_row = line < n;
+        int index = is_row ? line : line - n;
+        auto& groups = is_row ? config.row_groups : config.col_groups;
+        int cross_first = is_row ? n : 0;
+
+        propagation.line_solves++;
+        config.ReadLine(line, line_cells);
+        if (!solver.UpdateState(groups[index], line_cells, &changed_cells)) {
+            if (!quiet) {
                 Logger::get()->error("Can't update the puzzle group state {}",
-                        config_.filename);
-                return false;
+                        config.filename);
             }
+            return false;
+        }
 
-            // A row is dead when all cells have known colors
-            bool is_dead = true;
-            for (auto num : masks[i]) {
-                if (__builtin_popcount(num) != 1) {
-                    is_dead = false;
-                    break;
+        // The crossing lines should be solved again with the changed cells
+        config.WriteCells(line, line_cells, changed_cells);
+        bool new_known = false;
+        for (int cell : changed_cells) {
+            bool known = IsOneColor(line_cells[cell]);
+            scheduler.Push(cross_first + cell, known);
+            new_known |= known;
+        }
+
+        // A line is dead when all cells have known colors
+        scheduler.Solved(line,
+                CountUnknownCells(line_cells.data(), line_cells.size()));
+
+        // Draw an extra image if needed
+        if (options_.draw.extra_moves && new_known && !quiet) {
+            DrawImage(config);
+        }
+    }
+    return true;
+}
+
+template <typename Mask>
+bool Puzzle::UpdateStateSweeps(Config<Mask>& config,
+        Propagation<Mask>& propagation, bool quiet) {
+    auto& scheduler = propagation.scheduler;
+    auto& lines = propagation.sweep_lines;
+    auto& unknown = propagation.sweep_unknown;
+    auto& solved = propagation.sweep_solved;
+    int n = config.n;
+    bool new_step;
+    while (scheduler.PopBatch(lines, new_step)) {
+        if (OutOfTime()) {
+            return false;
+        }
+
+        // Draw the current step if needed
+        if (options_.draw.moves && new_step && !quiet) {
+            DrawImage(config);
+        }
+
+        // The half-sweep has only rows or only columns, every line writes
+        // only its own cells
+        bool is_row = lines[0] < n;
+        int first = is_row ? 0 : n;
+        auto& groups = is_row ? config.row_groups : config.col_groups;
+        int cross_first = is_row ? n : 0;
+
+        // Every worker takes the next block of lines until all of them are
+        // solved. The scheduler isn't thread-safe, so the workers of the
+        // pool keep the crossing lines to be queued later
+        atomic<int> next_block(0);
+        auto solve_blocks = [&](int worker) {
+            auto& line_worker = propagation.workers[worker];
+            auto& changed_cells = line_worker.changed_cells;
+            int block;
+            while ((block = next_block++ * kSweepBlockLines) < lines.size()) {
+                int count = min<int>(kSweepBlockLines, lines.size() - block);
+                config.ReadLines(&lines[block], count, line_worker.block_cells);
+                for (int i = 0; i < count; i++) {
+                    int line = block + i;
+                    auto& line_cells = line_worker.block_cells[i];
+                    solved[line] = line_worker.solver.UpdateState(
+                            groups[lines[line] - first], line_cells,
+                            &changed_cells);
+                    if (!solved[line]) {
+                        continue;
+                    }
+
+                    config.WriteCells(lines[line], line_cells, changed_cells);
+                    for (int cell : changed_cells) {
+                        bool known = IsOneColor(line_cells[cell]);
+                        if (propagation.parallel) {
+                            line_worker.pushes.push_back(
+                                    {cross_first + cell, known});
+                        } else {
+                            scheduler.Push(cross_first + cell, known);
+                        }
+                    }
+                    unknown[line] = CountUnknownCells(line_cells.data(),
+                            line_cells.size());
                 }
             }
-            dead[i] = is_dead;
-
-            // Draw an extra image if needed
-            if (cli_args::extra_moves) {
-                UpdateCellValues();
-                int current_count = 0;
-                for (const auto& it : masks[i]) {
-                    if (__builtin_popcount(it) == 1) {
-                        current_count++;
-                    }
+        };
+        if (propagation.parallel) {
+            // A worker may run several tasks
+            for (auto& worker : propagation.workers) {
+                worker.pushes.clear();
+            }
+            // The tasks refer to the lambda, so they aren't copied to the
+            // heap
+            for (int i = 0; i < propagation.pool->thread_count(); i++) {
+                propagation.pool->Submit(std::ref(solve_blocks));
+            }
+            propagation.pool->Wait();
+            for (const auto& worker : propagation.workers) {
+                for (const auto& it : worker.pushes) {
+                    scheduler.Push(it.first, it.second);
                 }
+            }
+        } else {
+            solve_blocks(0);
+        }
+        propagation.line_solves += lines.size();
 
-                if (current_count != extra_move_count) {
-                    DrawImage();
+        for (int line = 0; line < lines.size(); line++) {
+            if (!solved[line]) {
+                if (!quiet) {
+                    Logger::get()->error("Can't update the puzzle group "
+                            "state {}", config.filename);
                 }
+                return false;
             }
+            scheduler.Solved(lines[line], unknown[line]);
         }
     }
     return true;
 }
 
-bool Puzzle::UpdateState(OneLineSolver& solver, vector<int8_t>& dead_rows,
-        vector<int8_t>& dead_cols) {
-    auto& row_masks = config_.row_masks;
-    auto& col_masks = config_.col_masks;
-    auto& row_groups = config_.row_groups;
-    auto& col_groups = config_.col_groups;
+template <typename Mask>
+struct Puzzle::SearchState {
+    ThreadPool* pool;
 
-    if (!UpdateGroupsState(solver, dead_rows, row_groups, row_masks)) {
-        return false;
+    // Every worker has its own copy of the puzzle and its own line solver
+    vector<Config<Mask>> configs;
+    vector<unique_ptr<Propagation<Mask>>> propagations;
+
+    // Set when the search should be stopped
+    atomic<bool> stop;
+
+    // The search is stopped when max_solutions are found
+    int max_solutions;
+
+    // Guards the solutions count and the first solution
+    mutex solution_mutex;
+    int solutions;
+    vector<Mask> solution;
+
+    // The statistics of the nodes
+    atomic<int64_t> nodes;
+    atomic<int64_t> dead_ends;
+    atomic<int> max_depth;
+};
+
+template <typename Mask>
+int Puzzle::Search(Config<Mask>& config, int max_solutions) {
+    auto start_time = std::chrono::steady_clock::now();
+    ThreadPool pool(options_.threads);
+    int thread_count = pool.thread_count();
+
+    SearchState<Mask> state;
+    state.pool = &pool;
+    state.stop = false;
+    state.max_solutions = max_solutions;
+    state.solutions = 0;
+    state.nodes = 0;
+    state.dead_ends = 0;
+    state.max_depth = 0;
+    for (int worker = 0; worker < thread_count; worker++) {
+        Config<Mask> worker_config;
+        static_cast<Description&>(worker_config) = config;
+        state.configs.push_back(move(worker_config));
+        state.propagations.push_back(make_unique<Propagation<Mask>>());
+        if (!InitPropagation(config, *state.propagations.back())) {
+            return -1;
+        }
+        state.propagations.back()->workers[0].solver.SetQuiet(true);
     }
 
+    // The root is the state where the line solving has stopped
+    auto root = make_shared<SearchNode<Mask>>();
+    root->cells = config.cells;
+    root->row = -1;
+    root->depth = 0;
+    pool.Submit([this, &state, root](int worker) {
+        SearchStep(state, root, worker);
+    });
+    pool.Wait();
 
-    if (!UpdateGroupsState(solver, dead_cols, col_groups, col_masks)) {
-        return false;
+    int64_t search_solves = 0;
+    for (const auto& it : state.propagations) {
+        search_solves += it->line_solves;
     }
+    line_solves_ += search_solves;
+    int64_t nodes = state.nodes;
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time).count();
+    Logger::get()->info("The search has visited {} nodes in {} seconds on {} "
+            "threads: {} dead ends, max depth {}, {} steals", nodes, seconds,
+            thread_count, state.dead_ends.load(), state.max_depth.load(),
+            pool.steals());
+    Logger::get()->info("The search has made {} line solves, {:.1f} per node",
+            search_solves, nodes ? static_cast<double>(search_solves) /
+            static_cast<double>(nodes) : 0.0);
 
-    return true;
+    if (state.solutions > 0) {
+        config.cells = move(state.solution);
+    }
+    return state.solutions;
 }
 
-bool Puzzle::Solve(const string& filename) {
-    config_.filename = filename;
-    image_count_ = 0;
+template <typename Mask>
+void Puzzle::SearchStep(SearchState<Mask>& state,
+        shared_ptr<SearchNode<Mask>> node, int worker) {
+    if (state.stop || OutOfTime()) {
+        state.stop = true;
+        return;
+    }
+    state.nodes++;
+    int depth = node->depth;
+    int max_depth = state.max_depth;
+    while (depth > max_depth &&
+            !state.max_depth.compare_exchange_weak(max_depth, depth)) {
+    }
+
+    Config<Mask>& config = state.configs[worker];
+    Propagation<Mask>& propagation = *state.propagations[worker];
+    config.cells.swap(node->cells);
+
+    // Set the guessed color and solve the lines crossing the cell
+    if (node->row >= 0) {
+        int row = node->row;
+        int col = node->col;
+        config.cell(row, col) = ColorMask<Mask>(node->color);
+        propagation.scheduler.Init(propagation.heuristic, config.row_groups,
+                config.col_groups, false);
+        propagation.scheduler.Push(row, true);
+        propagation.scheduler.Push(config.n + col, true);
+        if (!UpdateState(config, propagation, true)) {
+            state.dead_ends++;
+            return;
+        }
+    }
+
+    // Branch on the unknown cell with the least colors
+    int best_row = -1;
+    int best_col = -1;
+    int best_count = 0;
+    for (int row = 0; row < config.n; row++) {
+        for (int col = 0; col < config.m; col++) {
+            int count = CountColors(config.cell(row, col));
+            if (count > 1 && (best_row < 0 || count < best_count)) {
+                best_row = row;
+                best_col = col;
+                best_count = count;
+            }
+        }
+    }
+
+    // All the lines are solved and all the cells are known
+    if (best_row < 0) {
+        lock_guard<mutex> lock(state.solution_mutex);
+        if (state.solutions == state.max_solutions) {
+            return;
+        }
+        if (++state.solutions == 1) {
+            state.solution = config.cells;
+        }
+        if (state.solutions == state.max_solutions) {
+            state.stop = true;
+        }
+        return;
+    }
+
+    // The last submitted child is taken first by this worker, so the colors
+    // are tried in the ascending order
+    Mask mask = config.cell(best_row, best_col);
+    vector<int> colors;
+    while (mask) {
+        int color = FirstColor(mask);
+        colors.push_back(color);
+        mask &= mask - 1;
+    }
+    for (int i = colors.size() - 1; i >= 0; i--) {
+        auto child = make_shared<SearchNode<Mask>>();
+        child->cells = config.cells;
+        child->row = best_row;
+        child->col = best_col;
+        child->color = colors[i];
+        child->depth = depth + 1;
+        state.pool->Submit([this, &state, child](int worker) {
+            SearchStep(state, child, worker);
+        });
+    }
+}
+
+void Puzzle::SetName(const string& name) {
+    context_->description.filename = name;
+}
+
+void Puzzle::SetDeadline(std::chrono::steady_clock::time_point deadline) {
+    deadline_ = deadline;
+}
+
+bool Puzzle::OutOfTime() {
+    if (!timed_out_ && std::chrono::steady_clock::now() >= deadline_) {
+        timed_out_ = true;
+    }
+    return timed_out_;
+}
+
+void Puzzle::GetCells(int& rows, int& columns, vector<int>& colors) const {
+    if (solved_color_count_ <= MaxMaskColors<uint8_t>()) {
+        GetMaskCells<uint8_t>(rows, columns, colors);
+    } else if (solved_color_count_ <= MaxMaskColors<uint16_t>()) {
+        GetMaskCells<uint16_t>(rows, columns, colors);
+    } else if (solved_color_count_ <= MaxMaskColors<uint32_t>()) {
+        GetMaskCells<uint32_t>(rows, columns, colors);
+    } else {
+        GetMaskCells<uint64_t>(rows, columns, colors);
+    }
+}
+
+const vector<Puzzle::Color>& Puzzle::colors() const {
+    return solved_description().colors;
+}
+
+const Puzzle::Description& Puzzle::solved_description() const {
+    if (solved_color_count_ <= MaxMaskColors<uint8_t>()) {
+        return context_->masks<uint8_t>().config;
+    } else if (solved_color_count_ <= MaxMaskColors<uint16_t>()) {
+        return context_->masks<uint16_t>().config;
+    } else if (solved_color_count_ <= MaxMaskColors<uint32_t>()) {
+        return context_->masks<uint32_t>().config;
+    }
+    return context_->masks<uint64_t>().config;
+}
+
+template <typename Mask>
+void Puzzle::GetMaskCells(int& rows, int& columns,
+        vector<int>& colors) const {
+    const Config<Mask>& config = context_->masks<Mask>().config;
+    rows = config.n;
+    columns = config.m;
+    colors.resize(config.cells.size());
+    for (int i = 0; i < config.cells.size(); i++) {
+        Mask mask = config.cells[i];
+        colors[i] = IsOneColor(mask) ? FirstColor(mask) : -1;
+    }
+}
+
+bool Puzzle::Read(const string& filename) {
+    MappedFile file;
+    if (!file.Open(filename)) {
+        Logger::get()->error("Can't open file {}", filename);
+        return false;
+    }
+    return Read(filename, file.data(), file.size());
+}
 
-    if (cli_args::black) {
-        if (!ReadBlack(filename))  {
+bool Puzzle::Read(const string& name, const char* data, size_t size) {
+    if (IsCompiled(name)) {
+        if (!ReadCompiled(data, size)) {
+            Logger::get()->error("Can't read the compiled puzzle file {}",
+                    name);
+            return false;
+        }
+    } else if (options_.black) {
+        if (!ReadBlack(data, size))  {
             Logger::get()->error("Can't read the black-white puzzle file {}",
-                    filename);
+                    name);
             return false;
         }
     } else {
-        if (!ReadColored(filename))  {
+        if (!ReadColored(data, size))  {
             Logger::get()->error("Can't read the colored puzzle file {}",
-                    filename);
+                    name);
             return false;
         }
     }
+    return true;
+}
+
+bool Puzzle::Solve(const string& filename) {
+    SetName(filename);
+    return Read(filename) && Solve();
+}
 
-    int n = config_.n;
-    int m = config_.m;
-    int color_count = config_.color_count;
-    auto& row_masks = config_.row_masks;
-    auto& col_masks = config_.col_masks;
+bool Puzzle::Solve(const string& name, const char* data, size_t size) {
+    SetName(name);
+    return Read(name, data, size) && Solve();
+}
 
-    // Initially, allow all colors for all cells
-    row_masks.resize(n);
-    for (int row = 0; row < n; row++) {
-        row_masks[row].resize(m, (1 << color_count) - 1);
+bool Puzzle::Solve() {
+    // Choose the narrowest cell mask, the line solver complains about
+    // too many colors
+    image_count_ = 0;
+    int color_count = context_->description.color_count;
+    solved_color_count_ = color_count;
+    timed_out_ = false;
+    if (color_count <= MaxMaskColors<uint8_t>()) {
+        return SolveMasks<uint8_t>();
+    } else if (color_count <= MaxMaskColors<uint16_t>()) {
+        return SolveMasks<uint16_t>();
+    } else if (color_count <= MaxMaskColors<uint32_t>()) {
+        return SolveMasks<uint32_t>();
     }
+    return SolveMasks<uint64_t>();
+}
 
-    col_masks.resize(m);
-    for (int col = 0; col < m; col++) {
-        col_masks[col].resize(n, (1 << color_count) - 1);
+template <typename Mask>
+bool Puzzle::InitLineWorker(const Config<Mask>& config,
+        LineWorker<Mask>& worker) {
+    worker.block_cells.resize(kSweepBlockLines);
+    OneLineSolver<Mask>& solver = worker.solver;
+    // White-black lines are solved faster with bitsets, unless another engine
+    // is asked for
+    LineSolverEngine engine = options_.line_solver;
+    if (config.color_count == 2 && !options_.line_solver_set) {
+        engine = LineSolverEngine::kBitset;
     }
+    if (!solver.Init(max(config.n, config.m), config.color_count, engine)) {
+        return false;
+    }
+    if (options_.line_cache && options_.line_cache->Enabled()) {
+        solver.SetLineCache(options_.line_cache);
+    }
+    solver.SetOverlap(options_.overlap);
+    return true;
+}
 
-    // Solve the puzzle line by line
-    OneLineSolver solver;
-    solver.Init(max(n, m), color_count);
+template <typename Mask>
+bool Puzzle::InitPropagation(const Config<Mask>& config,
+        Propagation<Mask>& propagation) {
+    // The workers of the previous puzzles are kept with their buffers
+    if (propagation.workers.empty()) {
+        propagation.workers.resize(1);
+    }
+    propagation.worker_count = 1;
+    if (!InitLineWorker(config, propagation.workers[0])) {
+        return false;
+    }
+    int max_lines = max(config.n, config.m);
+    propagation.sweep_unknown.resize(max_lines);
+    propagation.sweep_solved.resize(max_lines);
 
-    vector<int8_t> dead_rows(n);
-    vector<int8_t> dead_cols(m);
+    // Every line is solved at least once, then the lines are solved again
+    // only when their cells change
+    propagation.heuristic = options_.heuristic;
+    propagation.scheduler.Init(propagation.heuristic, config.row_groups,
+            config.col_groups);
+    propagation.line_solves = 0;
+    return true;
+}
 
-    int64_t prev_sum = LLONG_MAX;
-    while (true) {
-        // Draw the current step if needed
-        if (cli_args::moves) {
-            DrawImage();
-        }
+template <typename Mask>
+bool Puzzle::InitParallelSweeps(const Config<Mask>& config,
+        Propagation<Mask>& propagation) {
+    // The images of --extra-moves are drawn after every line
+    int thread_count = options_.threads;
+    if (thread_count <= 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    if (config.n * config.m < kMinParallelSweepCells ||
+            propagation.heuristic != LineScheduler::Heuristic::kSweep ||
+            options_.draw.extra_moves || thread_count < 2) {
+        propagation.parallel = false;
+        return true;
+    }
 
-        if (!UpdateState(solver, dead_rows, dead_cols)) {
-            Logger::get()->error("Can't update the puzzle state {}", filename);
+    if (propagation.workers.size() < thread_count) {
+        propagation.workers.resize(thread_count);
+    }
+    propagation.worker_count = thread_count;
+    for (int i = 1; i < thread_count; i++) {
+        if (!InitLineWorker(config, propagation.workers[i])) {
             return false;
         }
+    }
+    // The pool of the previous puzzles of the context is kept, also while
+    // the small puzzles are solved on one thread
+    if (!propagation.pool || propagation.pool->thread_count() != thread_count) {
+        propagation.pool = make_unique<ThreadPool>(thread_count);
+    }
+    propagation.parallel = true;
+    Logger::get()->info("The half-sweeps are solved on {} threads",
+            thread_count);
+    return true;
+}
+
+template <typename Mask>
+bool Puzzle::SolveMasks() {
+    // Every config keeps the capacity of its biggest puzzle, so the puzzles
+    // of the different mask types don't take the vectors of each other
+    Config<Mask>& config = context_->masks<Mask>().config;
+    CopyDescription(context_->description, config);
 
-        int64_t curr_sum = UpdateCellValues();
-        if (curr_sum == prev_sum) {
-            Logger::get()->info("The solution process has stopped");
-            break;
+    const string& filename = config.filename;
+    int n = config.n;
+    int m = config.m;
+    int color_count = config.color_count;
+
+    // Initially, allow all colors for all cells
+    config.cells.assign(n * m, AllColorsMask<Mask>(color_count));
+
+    // Solve the puzzle line by line
+    Propagation<Mask>& propagation = context_->masks<Mask>().propagation;
+    if (!InitPropagation(config, propagation) ||
+            !InitParallelSweeps(config, propagation)) {
+        return false;
+    }
+
+    // The contradictions are a normal result when counting the solutions
+    int max_solutions = options_.count_solutions;
+    solution_count_ = -1;
+    for (int i = 0; i < propagation.worker_count; i++) {
+        propagation.workers[i].solver.SetQuiet(max_solutions > 0);
+    }
+    if (!UpdateState(config, propagation, max_solutions > 0)) {
+        if (timed_out_) {
+            Logger::get()->warn("The puzzle {} is out of time", filename);
+            return false;
+        }
+        if (max_solutions > 0) {
+            Logger::get()->info("The puzzle {} has no solutions", filename);
+            solution_count_ = 0;
+            return true;
         }
+        Logger::get()->error("Can't update the puzzle state {}", filename);
+        return false;
+    }
+    line_solves_ = propagation.line_solves;
+    Logger::get()->info("The solution process has stopped after {} line "
+            "solves", line_solves_);
+    int64_t overlap_solves = 0;
+    int64_t full_solves = 0;
+    for (int i = 0; i < propagation.worker_count; i++) {
+        overlap_solves += propagation.workers[i].solver.overlap_solves();
+        full_solves += propagation.workers[i].solver.full_solves();
+    }
+    Logger::get()->info("The overlap pre-pass has solved {} lines, {} lines "
+            "are fully solved", overlap_solves, full_solves);
 
-        prev_sum = curr_sum;
+    // Count the solutions up to the limit, the first one is drawn
+    if (max_solutions > 0) {
+        solution_count_ = Search(config, max_solutions);
+        if (solution_count_ < 0) {
+            return false;
+        }
+        if (timed_out_) {
+            Logger::get()->warn("The puzzle {} is out of time, {} solutions "
+                    "are found", filename, solution_count_);
+            return false;
+        }
+        if (solution_count_ == max_solutions) {
+            Logger::get()->info("The puzzle {} has at least {} solutions",
+                    filename, solution_count_);
+        } else {
+            Logger::get()->info("The puzzle {} has {} solutions", filename,
+                    solution_count_);
+        }
+        if (solution_count_ == 0) {
+            return true;
+        }
+    } else if (options_.search && Search(config, 1) <= 0) {
+        // Guess the colors of the cells left unknown
+        if (timed_out_) {
+            Logger::get()->warn("The puzzle {} is out of time", filename);
+        } else {
+            Logger::get()->error("Can't find a solution of the puzzle {}",
+                    filename);
+        }
+        return false;
     }
 
     // Check for undeterministic result
-    if (!CheckUniqieness()) {
+    if (!CheckUniqieness(config)) {
         Logger::get()->error("Can't solve the puzzle {}", filename);
         return false;
     }
 
-    DrawImage();
+    DrawImage(config);
+    if (paint_) {
+        paint_->ReleaseFrames();
+    }
     return true;
 }
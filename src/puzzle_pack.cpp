@@ -0,0 +1,283 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <puzzle_pack.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <logger.h>
+
+using std::min;
+using std::numeric_limits;
+using std::ofstream;
+using std::sort;
+using std::string;
+using std::vector;
+
+const char* PuzzlePack::kExtension = ".pzp";
+
+PuzzlePack::~PuzzlePack() {
+    Close();
+}
+
+bool PuzzlePack::IsPack(const string& filename) {
+    size_t length = strlen(kExtension);
+    return filename.size() >= length && filename.compare(
+            filename.size() - length, length, kExtension) == 0;
+}
+
+bool PuzzlePack::Open(const string& filename, bool mapped) {
+    Close();
+
+    // Read the header, the pack is only mapped or only read by pread()
+    PackHeader header;
+    size_t file_size;
+    if (mapped) {
+        if (!file_.Open(filename)) {
+            Logger::get()->error("Can't open file {}", filename);
+            return false;
+        }
+        file_size = file_.size();
+        if (file_size >= sizeof(header)) {
+            memcpy(&header, file_.data(), sizeof(header));
+        }
+    } else {
+        fd_ = open(filename.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd_ < 0 || fstat(fd_, &info) != 0) {
+            Logger::get()->error("Can't open file {}", filename);
+            Close();
+            return false;
+        }
+        file_size = info.st_size;
+        if (file_size >= sizeof(header) &&
+                !ReadAt(0, &header, sizeof(header))) {
+            Close();
+            return false;
+        }
+    }
+    if (file_size < sizeof(header)) {
+        Logger::get()->error("The file is too short for the header");
+        Close();
+        return false;
+    }
+    if (memcmp(header.magic, "PZP", 4) != 0 || header.version != kVersion) {
+        Logger::get()->error("The file isn't a pack of version {}",
+                kVersion);
+        Close();
+        return false;
+    }
+    uint64_t index_size = header.names - header.index;
+    if (header.index % kAlignment != 0 || header.index < sizeof(header) ||
+            header.names < header.index || header.names > file_size ||
+            index_size % sizeof(PackEntry) != 0 ||
+            index_size / sizeof(PackEntry) != header.count ||
+            header.count > numeric_limits<int>::max()) {
+        Logger::get()->error("The header doesn't match the file size");
+        Close();
+        return false;
+    }
+
+    count_ = header.count;
+    size_t names_size = file_size - header.names;
+    if (mapped) {
+        entries_ = reinterpret_cast<const PackEntry*>(file_.data() +
+                header.index);
+        names_ = file_.data() + header.names;
+    } else {
+        index_.resize(count_);
+        names_buffer_.resize(names_size);
+        if (!ReadAt(header.index, index_.data(), index_size) ||
+                !ReadAt(header.names, names_buffer_.data(), names_size)) {
+            Close();
+            return false;
+        }
+        entries_ = index_.data();
+        names_ = names_buffer_.data();
+    }
+    if (!CheckIndex(header.index, names_size)) {
+        Close();
+        return false;
+    }
+    open_ = true;
+    return true;
+}
+
+void PuzzlePack::Close() {
+    file_.Close();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = -1;
+    index_.clear();
+    names_buffer_.clear();
+    open_ = false;
+    count_ = 0;
+    entries_ = nullptr;
+    names_ = nullptr;
+}
+
+bool PuzzlePack::CheckIndex(uint64_t index, size_t names_size) const {
+    for (int i = 0; i < count_; i++) {
+        const PackEntry& entry = entries_[i];
+        if (entry.offset % kAlignment != 0 ||
+                entry.offset < sizeof(PackHeader) || entry.offset > index ||
+                entry.size > index - entry.offset) {
+            Logger::get()->error("The puzzle {} is out of the pack", i);
+            return false;
+        }
+        if (static_cast<uint64_t>(entry.name_offset) + entry.name_length >
+                names_size) {
+            Logger::get()->error("The name of the puzzle {} is out of the "
+                    "pack", i);
+            return false;
+        }
+        // The names are searched by the binary search
+        if (i > 0 && CompareName(i - 1, names_ + entry.name_offset,
+                    entry.name_length) >= 0) {
+            Logger::get()->error("The names of the pack aren't sorted");
+            return false;
+        }
+    }
+    return true;
+}
+
+string PuzzlePack::name(int index) const {
+    return string(names_ + entries_[index].name_offset,
+            entries_[index].name_length);
+}
+
+int PuzzlePack::CompareName(int index, const char* name,
+        size_t length) const {
+    const PackEntry& entry = entries_[index];
+    int result = memcmp(names_ + entry.name_offset, name,
+            min<size_t>(entry.name_length, length));
+    if (result != 0) {
+        return result;
+    }
+    return entry.name_length < length ? -1 : entry.name_length > length;
+}
+
+int PuzzlePack::Find(const string& name) const {
+    int left = 0;
+    int right = count_;
+    while (left < right) {
+        int middle = left + (right - left) / 2;
+        int result = CompareName(middle, name.data(), name.size());
+        if (result == 0) {
+            return middle;
+        }
+        if (result < 0) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return -1;
+}
+
+bool PuzzlePack::ReadAt(uint64_t offset, void* data, size_t size) const {
+    char* pos = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t count = pread(fd_, pos, size, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            Logger::get()->error("Can't read the pack at {}", offset);
+            return false;
+        }
+        pos += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool PuzzlePack::Load(int index, vector<char>& buffer, const char*& data,
+        size_t& size) const {
+    const PackEntry& entry = entries_[index];
+    size = entry.size;
+    if (fd_ < 0) {
+        data = file_.data() + entry.offset;
+        return true;
+    }
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+    data = buffer.data();
+    return ReadAt(entry.offset, buffer.data(), size);
+}
+
+bool PuzzlePack::Write(const string& filename, const string& path_to_puzzles,
+        vector<string> files) const {
+    sort(files.begin(), files.end());
+    ofstream fout(filename, ofstream::binary);
+    if (!fout) {
+        Logger::get()->error("Can't write file {}", filename);
+        return false;
+    }
+
+    // The header is written again when the positions are known
+    PackHeader header;
+    memcpy(header.magic, "PZP", 4);
+    header.version = kVersion;
+    header.count = files.size();
+    header.index = 0;
+    header.names = 0;
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // The files are copied one by one, so the pack isn't kept in the memory
+    vector<PackEntry> index(files.size());
+    string names;
+    vector<char> padding(kAlignment);
+    uint64_t offset = sizeof(header);
+    for (int i = 0; i < files.size(); i++) {
+        MappedFile file;
+        if (!file.Open(path_to_puzzles + files[i])) {
+            Logger::get()->error("Can't open file {}",
+                    path_to_puzzles + files[i]);
+            return false;
+        }
+        if (names.size() + files[i].size() >
+                numeric_limits<uint32_t>::max()) {
+            Logger::get()->error("The names of the puzzles are too long for "
+                    "the pack");
+            return false;
+        }
+        index[i].offset = offset;
+        index[i].size = file.size();
+        index[i].name_offset = names.size();
+        index[i].name_length = files[i].size();
+        names += files[i];
+
+        size_t padding_size = (kAlignment - file.size() % kAlignment) %
+            kAlignment;
+        fout.write(file.data(), file.size());
+        fout.write(padding.data(), padding_size);
+        offset += file.size() + padding_size;
+    }
+
+    header.index = offset;
+    header.names = offset + index.size() * sizeof(PackEntry);
+    fout.write(reinterpret_cast<const char*>(index.data()),
+            index.size() * sizeof(PackEntry));
+    fout.write(names.data(), names.size());
+    fout.seekp(0);
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!fout) {
+        Logger::get()->error("Can't write file {}", filename);
+        return false;
+    }
+    Logger::get()->info("Packed {} puzzles to {}", files.size(), filename);
+    return true;
+}
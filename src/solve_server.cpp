@@ -0,0 +1,397 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <solve_server.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <logger.h>
+
+using std::lock_guard;
+using std::make_shared;
+using std::make_unique;
+using std::max;
+using std::move;
+using std::mutex;
+using std::remove_if;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// Set by the signals stopping the server
+static volatile sig_atomic_t stop_requested = 0;
+// The end of the pipe written by the signal handler to wake the server
+static int signal_wake_fd = -1;
+
+static void HandleStop(int) {
+    stop_requested = 1;
+    char byte = 0;
+    if (signal_wake_fd >= 0 && write(signal_wake_fd, &byte, 1) < 0) {
+        // The pipe is full, the server is going to wake anyway
+    }
+}
+
+// Sends all the bytes, returns false if the connection is broken
+static bool SendAll(int fd, const void* data, size_t size) {
+    const char* pos = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t count = send(fd, pos, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        pos += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Receives all the bytes, returns false if the connection is broken or
+// closed
+static bool ReceiveAll(int fd, void* data, size_t size) {
+    char* pos = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t count = recv(fd, pos, size, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        pos += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Fills the address of the socket, returns false if the path is too long
+static bool GetAddress(const string& socket_path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        Logger::get()->error("The socket path {} is too long", socket_path);
+        return false;
+    }
+    memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+    return true;
+}
+
+struct SolveServer::Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() {
+        close(fd);
+    }
+
+    int fd;
+    // The bytes received and not parsed yet, used by the reading thread
+    string input;
+    // The count of the queued requests
+    int requests = 0;
+    // Set at the end of the stream, the queued requests are still answered
+    bool closed = false;
+
+    // Guards the responses written by the workers
+    mutex write_mutex;
+    // Set if a response can't be written, the next ones aren't written
+    bool broken = false;
+};
+
+SolveServer::SolveServer(int jobs, int max_in_flight, int timeout) :
+        jobs_(jobs), max_in_flight_(max(1, max_in_flight)),
+        timeout_(timeout) {}
+
+bool SolveServer::Run(const string& socket_path,
+        const SolveOptions& options) {
+    if (pipe(wake_fds_) != 0) {
+        Logger::get()->error("Can't create a pipe for the server");
+        return false;
+    }
+    fcntl(wake_fds_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_fds_[1], F_SETFL, O_NONBLOCK);
+    if (!Listen(socket_path)) {
+        close(wake_fds_[0]);
+        close(wake_fds_[1]);
+        return false;
+    }
+
+    // Every worker solves the requests with its own buffers, on its own
+    // thread unless the threads are set
+    SolveOptions solver_options = options;
+    solver_options.draw.enabled = false;
+    if (jobs_ != 1 && !solver_options.threads_set) {
+        solver_options.threads = 1;
+    }
+    pool_ = make_unique<ThreadPool>(jobs_);
+    solvers_.clear();
+    for (int i = 0; i < pool_->thread_count(); i++) {
+        solvers_.push_back(make_unique<StreamSolver>(solver_options));
+    }
+    results_.resize(pool_->thread_count());
+
+    stop_requested = 0;
+    signal_wake_fd = wake_fds_[1];
+    signal(SIGINT, HandleStop);
+    signal(SIGTERM, HandleStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    Logger::get()->info("Serving on {} with {} workers", socket_path,
+            pool_->thread_count());
+    // The messages of every request would slow the server down
+    Logger::SetLevel(spdlog::level::warn);
+
+    vector<pollfd> fds;
+    while (!stop_requested) {
+        // The sockets aren't polled when the limit is reached, the workers
+        // wake the thread when they are done
+        bool reading = in_flight_ < max_in_flight_;
+        int connection_count = connections_.size();
+        fds.clear();
+        fds.push_back({wake_fds_[0], POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+        for (const auto& it : connections_) {
+            fds.push_back({reading && !it->closed ? it->fd : -1, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+            Logger::get()->error("Can't poll the sockets of the server");
+            break;
+        }
+        if (stop_requested) {
+            break;
+        }
+
+        if (fds[0].revents) {
+            char buffer[256];
+            while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        if (fds[1].revents) {
+            Accept();
+        }
+        for (int i = 0; i < connection_count; i++) {
+            if (fds[i + 2].revents) {
+                Receive(*connections_[i]);
+            }
+        }
+
+        // The requests over the limit wait in the buffers, a closed
+        // connection is kept until they are queued. The queued requests
+        // keep their connection until they are answered
+        for (auto& it : connections_) {
+            if (!Dispatch(it)) {
+                it->closed = true;
+                it->input.clear();
+            }
+        }
+        connections_.erase(remove_if(connections_.begin(),
+                    connections_.end(), [this](const shared_ptr<Connection>&
+                        connection) {
+                    return connection->closed && !HasRequest(*connection);
+                }), connections_.end());
+    }
+
+    Logger::SetLevel(spdlog::level::info);
+    Logger::get()->info("Stopping the server, {} requests are being solved",
+            in_flight_.load());
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(socket_path.c_str());
+    pool_->Wait();
+    pool_.reset();
+    connections_.clear();
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal_wake_fd = -1;
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+    return true;
+}
+
+bool SolveServer::Listen(const string& socket_path) {
+    sockaddr_un address;
+    if (!GetAddress(socket_path, address)) {
+        return false;
+    }
+
+    // The socket file of a stopped server is removed, but not the socket
+    // of a running one and not the other files
+    struct stat info;
+    if (lstat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool running = fd >= 0 && connect(fd,
+                reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (running) {
+            Logger::get()->error("The socket {} is served by another process",
+                    socket_path);
+            return false;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_,
+                reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listen_fd_, kListenBacklog) != 0) {
+        Logger::get()->error("Can't listen on the socket {}: {}", socket_path,
+                strerror(errno));
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+        }
+        listen_fd_ = -1;
+        return false;
+    }
+    fcntl(listen_fd_, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+void SolveServer::Accept() {
+    while (true) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        // A worker doesn't wait forever for a client which doesn't read
+        timeval send_timeout = {kSendTimeout, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout,
+                sizeof(send_timeout));
+        connections_.push_back(make_shared<Connection>(fd));
+    }
+}
+
+void SolveServer::Receive(Connection& connection) {
+    string& input = connection.input;
+    size_t size = input.size();
+    input.resize(size + kReadChunk);
+    ssize_t count = recv(connection.fd, &input[size], kReadChunk,
+            MSG_DONTWAIT);
+    input.resize(size + max<ssize_t>(count, 0));
+    if (count == 0 || (count < 0 && errno != EAGAIN &&
+                errno != EWOULDBLOCK && errno != EINTR)) {
+        connection.closed = true;
+    }
+}
+
+bool SolveServer::Dispatch(const shared_ptr<Connection>& connection) {
+    string& input = connection->input;
+    size_t pos = 0;
+    RequestHeader header;
+    while (in_flight_ < max_in_flight_ &&
+            input.size() - pos >= sizeof(header)) {
+        memcpy(&header, input.data() + pos, sizeof(header));
+        if (header.size > kMaxRequestSize) {
+            Logger::get()->warn("A request of {} bytes is too big, the "
+                    "connection is closed", header.size);
+            return false;
+        }
+        if (input.size() - pos - sizeof(header) < header.size) {
+            break;
+        }
+
+        // The time limit counts the time in the queue
+        int timeout = header.timeout ? header.timeout : timeout_;
+        StreamSolver::Deadline deadline = StreamSolver::GetDeadline(timeout);
+        string request = input.substr(pos + sizeof(header), header.size);
+        int number = ++connection->requests;
+        in_flight_++;
+        pool_->Submit([this, connection, number, request = move(request),
+                deadline](int worker) {
+            Solve(connection, number, request, deadline, worker);
+        });
+        pos += sizeof(header) + header.size;
+    }
+    input.erase(0, pos);
+    return true;
+}
+
+bool SolveServer::HasRequest(const Connection& connection) const {
+    const string& input = connection.input;
+    RequestHeader header;
+    if (input.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, input.data(), sizeof(header));
+    return input.size() - sizeof(header) >= header.size;
+}
+
+void SolveServer::Solve(const shared_ptr<Connection>& connection, int number,
+        const string& request, StreamSolver::Deadline deadline, int worker) {
+    string& result = results_[worker];
+    solvers_[worker]->SolveRecord(number, request.data(), request.size(),
+            deadline, result);
+    {
+        lock_guard<mutex> lock(connection->write_mutex);
+        uint32_t size = result.size();
+        if (!connection->broken && (!SendAll(connection->fd, &size,
+                        sizeof(size)) ||
+                    !SendAll(connection->fd, result.data(), size))) {
+            // The reading thread gets the end of the stream
+            connection->broken = true;
+            shutdown(connection->fd, SHUT_RDWR);
+        }
+    }
+    in_flight_--;
+    Wake();
+}
+
+void SolveServer::Wake() {
+    char byte = 0;
+    if (write(wake_fds_[1], &byte, 1) < 0) {
+        // The pipe is full, the thread is going to wake anyway
+    }
+}
+
+int SolveServer::Connect(const string& socket_path) {
+    sockaddr_un address;
+    if (!GetAddress(socket_path, address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) != 0) {
+        Logger::get()->error("Can't connect to the socket {}: {}",
+                socket_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+bool SolveServer::SendRequest(int fd, const char* data, size_t size,
+        uint32_t timeout) {
+    RequestHeader header;
+    header.size = size;
+    header.timeout = timeout;
+    return SendAll(fd, &header, sizeof(header)) && SendAll(fd, data, size);
+}
+
+bool SolveServer::ReceiveResponse(int fd, string& response) {
+    uint32_t size;
+    if (!ReceiveAll(fd, &size, sizeof(size))) {
+        return false;
+    }
+    response.resize(size);
+    return ReceiveAll(fd, &response[0], size);
+}
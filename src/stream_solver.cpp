@@ -0,0 +1,163 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <stream_solver.h>
+
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#include <logger.h>
+#include <timespan.h>
+
+using std::exception;
+using std::getline;
+using std::istream;
+using std::ostream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+StreamSolver::StreamSolver(const SolveOptions& options) : options_(options) {}
+
+StreamSolver::Deadline StreamSolver::GetDeadline(int timeout) {
+    if (timeout <= 0) {
+        return Deadline::max();
+    }
+    return std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(timeout);
+}
+
+bool StreamSolver::Run(istream& in, ostream& out, int timeout) {
+    // The messages of every puzzle would slow the stream down
+    Logger::SetLevel(spdlog::level::warn);
+
+    string line;
+    string record;
+    string result;
+    int number = 0;
+    while (true) {
+        bool read = static_cast<bool>(getline(in, line));
+        if (read && !line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (read && line != kSeparator) {
+            record += line;
+            record += '\n';
+            continue;
+        }
+
+        // The empty records are skipped, so the stream may end with the
+        // separator
+        if (record.find_first_not_of(" \t\n\v\f\r") != string::npos) {
+            SolveRecord(++number, record.data(), record.size(),
+                    GetDeadline(timeout), result);
+            // The results are flushed for the reader waiting for them
+            out << result << '\n';
+            out.flush();
+            if (!out) {
+                Logger::get()->error("Can't write the result of the puzzle "
+                        "{}", number);
+                return false;
+            }
+        }
+        record.clear();
+        if (!read) {
+            break;
+        }
+    }
+
+    Logger::SetLevel(spdlog::level::info);
+    return true;
+}
+
+void StreamSolver::SolveRecord(int number, const char* data, size_t size,
+        Deadline deadline, string& result) {
+    name_ = "#";
+    name_ += to_string(number);
+
+    Timespan ts;
+    Puzzle puzzle(options_, &context_);
+    puzzle.SetDeadline(deadline);
+    // A broken puzzle is the error of its record, the other puzzles of the
+    // stream are still solved
+    try {
+        bool solved = puzzle.Solve(name_, data, size) &&
+            puzzle.solution_count() != 0;
+        WriteResult(number, puzzle, solved, ts.Peek(), result);
+    } catch (const exception& e) {
+        Logger::get()->error("Can't solve the puzzle {}: {}", name_,
+                e.what());
+        WriteError(number, e.what(), ts.Peek(), result);
+    }
+}
+
+void StreamSolver::WriteResult(int number, const Puzzle& puzzle, bool solved,
+        double time, string& result) {
+    result = "{\"puzzle\":";
+    result += to_string(number);
+    result += solved ? ",\"solved\":true" : ",\"solved\":false";
+    if (!solved && puzzle.timed_out()) {
+        result += ",\"timed_out\":true";
+    }
+    // The count is up to the limit, it's the count found so far if the
+    // puzzle is out of time
+    if (options_.count_solutions > 0 && puzzle.solution_count() >= 0) {
+        result += ",\"solutions\":";
+        result += to_string(puzzle.solution_count());
+    }
+    if (solved) {
+        int rows;
+        int columns;
+        puzzle.GetCells(rows, columns, cells_);
+        result += ",\"rows\":";
+        result += to_string(rows);
+        result += ",\"columns\":";
+        result += to_string(columns);
+
+        // The runs of the cells of the same color
+        result += ",\"grid\":\"";
+        for (int i = 0, next = 0; i < cells_.size(); i = next) {
+            while (next < cells_.size() && cells_[next] == cells_[i]) {
+                next++;
+            }
+            if (i > 0) {
+                result += ' ';
+            }
+            result += to_string(next - i);
+            result += ' ';
+            result += to_string(cells_[i]);
+        }
+        result += '"';
+    }
+    result += ",\"line_solves\":";
+    result += to_string(puzzle.line_solves());
+    AppendTime(time, result);
+}
+
+void StreamSolver::WriteError(int number, const char* error, double time,
+        string& result) {
+    // The buffers of the failed puzzle are released, the message is short
+    cells_ = vector<int>();
+    result = string();
+    result += "{\"puzzle\":";
+    result += to_string(number);
+    result += ",\"solved\":false,\"error\":\"";
+    for (const char* c = error; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            result += '\\';
+        }
+        result += static_cast<unsigned char>(*c) < ' ' ? ' ' : *c;
+    }
+    result += '"';
+    AppendTime(time, result);
+}
+
+void StreamSolver::AppendTime(double time, string& result) {
+    char time_text[32];
+    snprintf(time_text, sizeof(time_text), "%.9g", time);
+    result += ",\"time\":";
+    result += time_text;
+    result += '}';
+}
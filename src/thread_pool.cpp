@@ -0,0 +1,150 @@
+/* 
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <thread_pool.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using std::lock_guard;
+using std::make_unique;
+using std::max;
+using std::move;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+
+thread_local const ThreadPool* ThreadPool::current_pool_ = nullptr;
+thread_local int ThreadPool::current_worker_ = -1;
+
+ThreadPool::ThreadPool(int thread_count) : next_queue_(0), steals_(0) {
+    if (thread_count <= 0) {
+        thread_count = thread::hardware_concurrency();
+    }
+    if (thread_count <= 0) {
+        thread_count = 1;
+    }
+    for (int i = 0; i < thread_count; i++) {
+        queues_.push_back(make_unique<Queue>());
+    }
+    for (int i = 0; i < thread_count; i++) {
+        threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    task_added_.notify_all();
+    for (auto& it : threads_) {
+        it.join();
+    }
+}
+
+void ThreadPool::Submit(Task task) {
+    int queue = current_pool_ == this ? current_worker_ : -1;
+    if (queue < 0) {
+        queue = next_queue_++ % queues_.size();
+    }
+    // Count the task before publishing it, otherwise it may be stolen and
+    // finished first, and pending_ would reach 0 while its parent runs
+    {
+        lock_guard<mutex> lock(mutex_);
+        queued_++;
+        pending_++;
+    }
+    {
+        lock_guard<mutex> lock(queues_[queue]->mutex);
+        queues_[queue]->PushBack(move(task));
+    }
+    task_added_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    unique_lock<mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::Queue::PushBack(Task task) {
+    if (size == tasks.size()) {
+        // The tasks are moved to the start of a twice bigger buffer
+        std::vector<Task> grown(max(kMinSize, 2 * size));
+        for (size_t i = 0; i < size; i++) {
+            grown[i] = move(tasks[(head + i) % tasks.size()]);
+        }
+        tasks.swap(grown);
+        head = 0;
+    }
+    tasks[(head + size) % tasks.size()] = move(task);
+    size++;
+}
+
+void ThreadPool::Queue::PopBack(Task& task) {
+    // The taken slot is cleared, so it doesn't keep the captures of the task
+    Task& slot = tasks[(head + size - 1) % tasks.size()];
+    task = move(slot);
+    slot = nullptr;
+    size--;
+}
+
+void ThreadPool::Queue::PopFront(Task& task) {
+    task = move(tasks[head]);
+    tasks[head] = nullptr;
+    head = (head + 1) % tasks.size();
+    size--;
+}
+
+bool ThreadPool::TakeTask(int worker, Task& task) {
+    bool taken = false;
+    {
+        Queue& own = *queues_[worker];
+        lock_guard<mutex> lock(own.mutex);
+        if (own.size > 0) {
+            own.PopBack(task);
+            taken = true;
+        }
+    }
+    for (int i = 1; !taken && i < queues_.size(); i++) {
+        Queue& other = *queues_[(worker + i) % queues_.size()];
+        lock_guard<mutex> lock(other.mutex);
+        if (other.size > 0) {
+            other.PopFront(task);
+            taken = true;
+            steals_++;
+        }
+    }
+    if (taken) {
+        lock_guard<mutex> lock(mutex_);
+        queued_--;
+    }
+    return taken;
+}
+
+void ThreadPool::WorkerLoop(int worker) {
+    current_pool_ = this;
+    current_worker_ = worker;
+    while (true) {
+        Task task;
+        if (TakeTask(worker, task)) {
+            task(worker);
+            lock_guard<mutex> lock(mutex_);
+            if (--pending_ == 0) {
+                all_done_.notify_all();
+            }
+            continue;
+        }
+
+        // Sleep until a task is added
+        unique_lock<mutex> lock(mutex_);
+        task_added_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2018 Evgeny Shulgin <izaronplatz@gmail.com>
+ * This code is released under the license described in the LICENSE file
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <compiled_puzzle.h>
+#include <nonograms.h>
+
+using std::pair;
+using std::vector;
+
+// The groups of a line are the pairs of the length and the color index
+typedef vector<pair<int, int>> Line;
+
+// Writes a compiled puzzle of the white-black-gray colors to the buffer,
+// the buffer of uint32_t keeps the file aligned
+static void Compile(int rows, int columns, const vector<Line>& lines,
+        vector<uint32_t>& buffer) {
+    CompiledHeader header;
+    memcpy(header.magic, "PZB", 4);
+    header.version = 1;
+    header.rows = rows;
+    header.columns = columns;
+    header.color_count = 3;
+    header.group_count = 0;
+    for (const auto& line : lines) {
+        header.group_count += line.size();
+    }
+
+    CompiledLayout layout(header);
+    buffer.assign((layout.size + 3) / 4, 0);
+    char* data = reinterpret_cast<char*>(buffer.data());
+    memcpy(data, &header, sizeof(header));
+    const uint8_t palette[] = {255, 255, 255, 0, 0, 0, 128, 128, 128};
+    memcpy(data + layout.palette, palette, sizeof(palette));
+    uint32_t* offsets = reinterpret_cast<uint32_t*>(data + layout.offsets);
+    uint16_t* lengths = reinterpret_cast<uint16_t*>(data + layout.lengths);
+    uint8_t* colors = reinterpret_cast<uint8_t*>(data + layout.colors);
+    offsets[0] = 0;
+    for (int i = 0; i < lines.size(); i++) {
+        offsets[i + 1] = offsets[i] + lines[i].size();
+        for (const auto& group : lines[i]) {
+            *lengths++ = group.first;
+            *colors++ = group.second;
+        }
+    }
+}
+
+// Solves the compiled puzzle with the line solver engines, returns false
+// if a status isn't the expected one
+static bool Check(const char* name, int rows, int columns,
+        const vector<Line>& lines, int expected) {
+    vector<uint32_t> buffer;
+    Compile(rows, columns, lines, buffer);
+    CompiledHeader header;
+    memcpy(&header, buffer.data(), sizeof(header));
+    nono_config config = {reinterpret_cast<const char*>(buffer.data()),
+        CompiledLayout(header).size, NONO_FORMAT_COMPILED, name};
+
+    // The bitset engine solves only the white-black puzzles
+    const int engines[] = {NONO_LINE_SOLVER_DEFAULT,
+        NONO_LINE_SOLVER_ITERATIVE, NONO_LINE_SOLVER_RECURSIVE};
+    bool passed = true;
+    for (int engine : engines) {
+        for (int overlap = 0; overlap <= 1; overlap++) {
+            nono_options opts;
+            nono_options_init(&opts);
+            opts.line_solver = engine;
+            opts.overlap = overlap;
+            nono_result result;
+            int status = nono_solve(&config, &opts, &result);
+            nono_result_free(&result);
+            if (status != expected) {
+                fprintf(stderr, "%s: the status is %d with the engine %d "
+                        "and the overlap %d, expected %d\n", name, status,
+                        engine, overlap, expected);
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
+
+int main() {
+    // The cells are black and gray:
+    //    B G
+    //    G G
+    const Line black_gray = {{1, 1}, {1, 2}};
+    const Line gray = {{2, 2}};
+    bool passed = Check("valid", 2, 2, {black_gray, gray, black_gray, gray},
+            NONO_SOLVED);
+
+    // The zero-length groups and the groups which don't fit the line are
+    // rejected by the loader instead of being solved
+    passed &= Check("zero length", 2, 2, {Line(40, {0, 1}), gray,
+            black_gray, gray}, NONO_INVALID_PUZZLE);
+    passed &= Check("too many groups", 2, 2, {Line(40, {1, 1}), gray,
+            black_gray, gray}, NONO_INVALID_PUZZLE);
+    passed &= Check("too long group", 2, 2, {{{3, 1}}, gray, black_gray,
+            gray}, NONO_INVALID_PUZZLE);
+    // The groups of the same color need a cell between them
+    passed &= Check("no gap", 2, 2, {{{1, 1}, {1, 1}}, gray, black_gray,
+            gray}, NONO_INVALID_PUZZLE);
+
+    if (!passed) {
+        return 1;
+    }
+    printf("All the compiled puzzles are checked\n");
+    return 0;
+}